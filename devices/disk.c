@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -68,11 +69,18 @@ struct channel {
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
+	struct lock lock;           /* Protects the request queue. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	/* Only the I/O thread touches the controller once it runs. */
+	struct list queue;          /* Pending requests, sorted by sector. */
+	struct list fifo;           /* Pending requests, oldest first. */
+	struct condition queue_cond;/* Signaled when a request is queued. */
+	int head_dev;               /* Device of the last transfer. */
+	disk_sector_t head_pos;     /* Sector after the last transfer. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
@@ -84,7 +92,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -96,6 +104,14 @@ static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
 
+static void disk_io_thread (void *channel_);
+static struct disk_request *pick_request (struct channel *);
+static size_t take_batch (struct channel *, struct disk_request *,
+		struct list *batch);
+static void transfer_batch (struct channel *, struct list *batch, size_t cnt);
+static bool request_less (const struct list_elem *, const struct list_elem *,
+		void *aux);
+
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
@@ -122,6 +138,11 @@ disk_init (void) {
 		lock_init (&c->lock);
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		list_init (&c->queue);
+		list_init (&c->fifo);
+		cond_init (&c->queue_cond);
+		c->head_dev = 0;
+		c->head_pos = 0;
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -150,6 +171,13 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* From here on requests go through the channel queue. */
+		if (c->devices[0].is_ata || c->devices[1].is_ata) {
+			char name[16];
+			snprintf (name, sizeof name, "%s_io", c->name);
+			thread_create (name, PRI_DEFAULT, disk_io_thread, c);
+		}
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -209,21 +237,21 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
+	disk_read_multiple (d, sec_no, 1, buffer);
+}
 
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+/* Reads CNT contiguous sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Up to DISK_MULTIPLE_MAX sectors are transferred by a
+   single READ SECTOR command.  Blocks until the data arrives. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer) {
+	struct disk_request req;
 
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_request_init (&req, d, sec_no, cnt, buffer, false);
+	disk_submit (&req, NULL, NULL);
+	disk_wait (&req);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -233,23 +261,215 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	disk_write_multiple (d, sec_no, 1, buffer);
+}
+
+/* Writes CNT contiguous sectors starting at SEC_NO to disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving all of the
+   data.  Batched like disk_read_multiple(). */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *buffer) {
+	struct disk_request req;
 
+	disk_request_init (&req, d, sec_no, cnt, (void *) buffer, true);
+	disk_submit (&req, NULL, NULL);
+	disk_wait (&req);
+}
+
+/* Initializes REQ to transfer CNT sectors starting at SEC_NO
+   between disk D and BUFFER.  WRITE selects the direction. */
+void
+disk_request_init (struct disk_request *req, struct disk *d,
+		disk_sector_t sec_no, size_t cnt, void *buffer, bool write) {
+	ASSERT (req != NULL);
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
+	ASSERT (sec_no + cnt <= d->capacity);
+
+	req->disk = d;
+	req->sec_no = sec_no;
+	req->cnt = cnt;
+	req->buffer = buffer;
+	req->write = write;
+	req->done = NULL;
+	req->aux = NULL;
+	sema_init (&req->complete, 0);
+}
+
+/* Queues REQ on its channel and returns immediately.
+   If DONE is non-null it is called with AUX from the channel's I/O
+   thread when the transfer completes, and REQ belongs to DONE from
+   then on.  Otherwise wait for completion with disk_wait(). */
+void
+disk_submit (struct disk_request *req, disk_done_func *done, void *aux) {
+	struct channel *c = req->disk->channel;
+
+	req->done = done;
+	req->aux = aux;
+	if (req->cnt == 0) {
+		if (done != NULL)
+			done (req, aux);
+		else
+			sema_up (&req->complete);
+		return;
+	}
 
-	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	req->deadline = timer_ticks () + DISK_DEADLINE_TICKS;
+	list_insert_ordered (&c->queue, &req->elem, request_less, NULL);
+	list_push_back (&c->fifo, &req->fifo_elem);
+	cond_signal (&c->queue_cond, &c->lock);
 	lock_release (&c->lock);
 }
-
+
+/* Blocks until REQ, submitted without a callback, completes. */
+void
+disk_wait (struct disk_request *req) {
+	ASSERT (req->done == NULL);
+	sema_down (&req->complete);
+}
+
+/* Disk request scheduling. */
+
+/* Per-channel I/O thread.  Serves queued requests in C-LOOK order,
+   except that a request past its deadline is served first, and
+   merges requests for adjacent sectors into one command. */
+static void
+disk_io_thread (void *channel_) {
+	struct channel *c = channel_;
+
+	for (;;) {
+		struct list batch;
+		size_t cnt;
+
+		lock_acquire (&c->lock);
+		while (list_empty (&c->queue))
+			cond_wait (&c->queue_cond, &c->lock);
+		cnt = take_batch (c, pick_request (c), &batch);
+		lock_release (&c->lock);
+
+		transfer_batch (c, &batch, cnt);
+
+		// REQ may be freed by its owner once completed
+		while (!list_empty (&batch)) {
+			struct disk_request *req =
+				list_entry (list_pop_front (&batch), struct disk_request, elem);
+			if (req->done != NULL)
+				req->done (req, req->aux);
+			else
+				sema_up (&req->complete);
+		}
+	}
+}
+
+/* Returns the next request to serve on channel C: the oldest one if
+   it is past its deadline, otherwise the first one at or after the
+   head position, wrapping around to the lowest sector. */
+static struct disk_request *
+pick_request (struct channel *c) {
+	struct list_elem *e;
+	struct disk_request *oldest =
+		list_entry (list_front (&c->fifo), struct disk_request, fifo_elem);
+
+	if (timer_ticks () >= oldest->deadline)
+		return oldest;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue); e = list_next (e)) {
+		struct disk_request *req = list_entry (e, struct disk_request, elem);
+		if (req->disk->dev_no > c->head_dev
+				|| (req->disk->dev_no == c->head_dev && req->sec_no >= c->head_pos))
+			return req;
+	}
+	return list_entry (list_front (&c->queue), struct disk_request, elem);
+}
+
+/* Removes FIRST and the queued requests that continue it on the same
+   disk in the same direction from C's queue into BATCH.
+   Returns the number of sectors in BATCH. */
+static size_t
+take_batch (struct channel *c, struct disk_request *first,
+		struct list *batch) {
+	struct list_elem *e = list_next (&first->elem);
+	disk_sector_t end = first->sec_no + first->cnt;
+	size_t cnt = first->cnt;
+
+	list_init (batch);
+	list_remove (&first->elem);
+	list_remove (&first->fifo_elem);
+	list_push_back (batch, &first->elem);
+
+	while (e != list_end (&c->queue)) {
+		struct disk_request *req = list_entry (e, struct disk_request, elem);
+		if (req->disk != first->disk || req->write != first->write
+				|| req->sec_no != end)
+			break;
+		e = list_remove (&req->elem);
+		list_remove (&req->fifo_elem);
+		list_push_back (batch, &req->elem);
+		end += req->cnt;
+		cnt += req->cnt;
+	}
+
+	c->head_dev = first->disk->dev_no;
+	c->head_pos = end;
+	return cnt;
+}
+
+/* Transfers the CNT contiguous sectors of the requests in BATCH,
+   issuing a new command every DISK_MULTIPLE_MAX sectors. */
+static void
+transfer_batch (struct channel *c, struct list *batch, size_t cnt) {
+	struct disk_request *first =
+		list_entry (list_front (batch), struct disk_request, elem);
+	struct disk *d = first->disk;
+	disk_sector_t sec_no = first->sec_no;
+	size_t left = 0;
+	struct list_elem *e;
+
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e)) {
+		struct disk_request *req = list_entry (e, struct disk_request, elem);
+		uint8_t *buf = req->buffer;
+
+		for (size_t i = 0; i < req->cnt; i++, sec_no++, cnt--) {
+			if (left == 0) {
+				left = cnt < DISK_MULTIPLE_MAX ? cnt : DISK_MULTIPLE_MAX;
+				select_sector (d, sec_no, left);
+				issue_pio_command (c, first->write ? CMD_WRITE_SECTOR_RETRY
+				                                   : CMD_READ_SECTOR_RETRY);
+			}
+			if (first->write) {
+				if (!wait_while_busy (d))
+					PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
+				output_sector (c, buf);
+				sema_down (&c->completion_wait);
+				d->write_cnt++;
+			} else {
+				sema_down (&c->completion_wait);
+				if (!wait_while_busy (d))
+					PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
+				input_sector (c, buf);
+				d->read_cnt++;
+			}
+			buf += DISK_SECTOR_SIZE;
+			left--;
+		}
+	}
+}
+
+/* Orders requests by device, then by first sector. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct disk_request *a = list_entry (a_, struct disk_request, elem);
+	const struct disk_request *b = list_entry (b_, struct disk_request, elem);
+
+	if (a->disk->dev_no != b->disk->dev_no)
+		return a->disk->dev_no < b->disk->dev_no;
+	return a->sec_no < b->sec_no;
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -402,17 +622,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.)  A count of 0 in the
+   register means 256 sectors. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= DISK_MULTIPLE_MAX);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == 256 ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
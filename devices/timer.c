@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/synch.h"
@@ -24,6 +25,44 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Hierarchical timer wheel.  Level 0 has a slot for each of the
+   next TVR_SIZE ticks.  A slot of an upper level covers one whole
+   turn of the level below and is cascaded down when that turn
+   begins, so arming is O(1) and a tick only touches the timers that
+   expire on it, plus the cascaded ones once every TVR_SIZE ticks. */
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+
+/* Wheel of the kernel timers, run by the timer interrupt. */
+static struct timer_wheel wheel;
+
+static void wheel_add (struct timer_wheel *, struct timer *);
+static int cascade (struct timer_wheel *, int level);
+
+/* Tickless idle.  While only the idle thread runs, the PIT is put
+   in one-shot mode to skip the ticks on which no timer expires.
+   Enabled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+#define PIT_HZ 1193180
+#define PIT_PERIODIC 0x34   /* Counter 0, LSB then MSB, mode 2, binary. */
+#define PIT_ONESHOT 0x30    /* Counter 0, LSB then MSB, mode 0, binary. */
+
+static uint16_t pit_count;      /* PIT input cycles per tick. */
+static uint16_t oneshot_count;  /* Count of the armed one-shot. */
+static int oneshot_ticks;       /* Ticks it covers, 0 if periodic. */
+static int64_t skipped_ticks;   /* Timer interrupts saved. */
+
+static void pit_program (uint8_t mode, uint16_t count);
+static uint16_t pit_read (void);
+static bool pit_irq_pending (void);
+static int wheel_idle_ticks (int max);
+
+/* Cycles spent in the timer interrupt handler. */
+static uint64_t intr_cycles;
+static uint64_t intr_max_cycles;
+static int64_t intr_cnt;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -34,13 +73,12 @@ static void real_time_sleep (int64_t num, int32_t denom);
    corresponding interrupt. */
 void
 timer_init (void) {
+	timer_wheel_init (&wheel, 0);
+
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
 	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	pit_count = (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ;
+	pit_program (PIT_PERIODIC, pit_count);
 
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -117,14 +155,262 @@ timer_nsleep (int64_t ns) {
 void
 timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	if (intr_cnt > 0)
+		printf ("Timer: interrupt %"PRIu64" cycles avg, %"PRIu64" cycles max\n",
+				intr_cycles / intr_cnt, intr_max_cycles);
+	if (timer_tickless)
+		printf ("Timer: %"PRId64" ticks skipped while idle\n", skipped_ticks);
 }
 
+/* Initializes timer T to call FUNC with AUX when it expires. */
+void
+timer_setup (struct timer *t, timer_func *func, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (func != NULL);
+
+	t->func = func;
+	t->aux = aux;
+	t->armed = false;
+}
+
+/* Arms T to fire at tick EXPIRES, re-arming it if it is already
+   pending.  A past EXPIRES fires on the next tick. */
+void
+timer_arm (struct timer *t, int64_t expires) {
+	enum intr_level old_level = intr_disable ();
+
+	timer_wheel_arm (&wheel, t, expires);
+	intr_set_level (old_level);
+}
+
+/* Disarms T.  Returns true if it was pending, false if it has
+   already fired or was never armed. */
+bool
+timer_cancel (struct timer *t) {
+	enum intr_level old_level = intr_disable ();
+	bool was_armed = t->armed;
+
+	if (was_armed) {
+		list_remove (&t->elem);
+		t->armed = false;
+	}
+	intr_set_level (old_level);
+	return was_armed;
+}
+
+/* Initializes W with no timers, its first tick to run is NOW. */
+void
+timer_wheel_init (struct timer_wheel *w, int64_t now) {
+	int i, level;
+
+	for (i = 0; i < TVR_SIZE; i++)
+		list_init (&w->tv1[i]);
+	for (level = 0; level < TVN_LEVELS; level++)
+		for (i = 0; i < TVN_SIZE; i++)
+			list_init (&w->tvn[level][i]);
+	w->ticks = now;
+}
+
+/* Arms T in W to fire at tick EXPIRES, re-arming it if it is
+   already pending.  A past EXPIRES fires on the next tick run.
+   The caller keeps W from being run meanwhile. */
+void
+timer_wheel_arm (struct timer_wheel *w, struct timer *t, int64_t expires) {
+	if (t->armed)
+		list_remove (&t->elem);
+	t->expires = expires;
+	t->armed = true;
+	wheel_add (w, t);
+}
+
+/* Fires every timer of W that expired up to tick NOW, in order of
+   expiry. */
+void
+timer_wheel_run (struct timer_wheel *w, int64_t now) {
+	int level;
+
+	while (w->ticks <= now) {
+		int index = w->ticks & TVR_MASK;
+		struct list *slot = &w->tv1[index];
+
+		if (index == 0)
+			for (level = 0; level < TVN_LEVELS && cascade (w, level) == 0; level++)
+				continue;
+		w->ticks++;
+
+		while (!list_empty (slot)) {
+			struct timer *t = list_entry (list_pop_front (slot), struct timer, elem);
+			t->armed = false;
+			t->func (t->aux);
+		}
+	}
+}
+
+/* Puts T in the slot of W for its expiry.  Timers beyond the
+   wheel's span sit in the last slot of the top level and are
+   placed again each time it is cascaded. */
+static void
+wheel_add (struct timer_wheel *w, struct timer *t) {
+	int64_t expires = t->expires;
+	int64_t idx = expires - w->ticks;
+	struct list *slot;
+	int level;
+
+	if (idx < 0)
+		slot = &w->tv1[w->ticks & TVR_MASK];
+	else if (idx < TVR_SIZE)
+		slot = &w->tv1[expires & TVR_MASK];
+	else {
+		if (idx >= TIMER_WHEEL_SPAN) {
+			expires = w->ticks + TIMER_WHEEL_SPAN - 1;
+			idx = TIMER_WHEEL_SPAN - 1;
+		}
+		for (level = 0; idx >= (int64_t) 1 << (TVR_BITS + (level + 1) * TVN_BITS);
+				level++)
+			continue;
+		slot = &w->tvn[level][(expires >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK];
+	}
+	list_push_back (slot, &t->elem);
+}
+
+/* Moves the timers of the current slot of upper LEVEL of W down
+   the wheel.  Returns the index of that slot. */
+static int
+cascade (struct timer_wheel *w, int level) {
+	int index = (w->ticks >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK;
+	struct list *slot = &w->tvn[level][index];
+	struct list moved;
+
+	// a timer may land in the same slot again, so empty it first
+	list_init (&moved);
+	if (!list_empty (slot))
+		list_splice (list_end (&moved), list_begin (slot), list_end (slot));
+	while (!list_empty (&moved))
+		wheel_add (w, list_entry (list_pop_front (&moved), struct timer, elem));
+	return index;
+}
+
+/* Called by the idle thread with interrupts off just before it
+   halts.  If no timer expires on the next few ticks, switches the
+   PIT to a one-shot that fires on the first tick that matters. */
+void
+timer_idle_enter (void) {
+	uint16_t left;
+	int n;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || oneshot_ticks > 0 || pit_irq_pending ())
+		return;
+	n = wheel_idle_ticks (UINT16_MAX / pit_count);
+	if (n < 2)
+		return;
+
+	// keep the tick phase: finish the current period, then N - 1 more
+	left = pit_read ();
+	oneshot_count = left + (n - 1) * pit_count;
+	oneshot_ticks = n;
+	pit_program (PIT_ONESHOT, oneshot_count);
+}
+
+/* Called by the idle thread after another interrupt woke it up
+   before the one-shot fired.  Accounts the whole ticks that have
+   passed and shortens the one-shot to the next tick boundary, so the
+   woken thread sees the right time and gets its time slices. */
+void
+timer_idle_exit (void) {
+	enum intr_level old_level = intr_disable ();
+	uint16_t left, elapsed;
+	int n;
+
+	if (oneshot_ticks > 0 && !pit_irq_pending ()) {
+		left = pit_read ();
+		elapsed = left <= oneshot_count ? oneshot_count - left : 0;
+		for (n = elapsed / pit_count; n > 0; n--) {
+			ticks++;
+			thread_idle_tick ();
+			skipped_ticks++;
+		}
+		timer_wheel_run (&wheel, ticks);
+
+		oneshot_count = pit_count - elapsed % pit_count;
+		oneshot_ticks = 1;
+		pit_program (PIT_ONESHOT, oneshot_count);
+	}
+	intr_set_level (old_level);
+}
+
+/* Programs PIT counter 0 with MODE and COUNT. */
+static void
+pit_program (uint8_t mode, uint16_t count) {
+	outb (0x43, mode);
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* Latch counter 0. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return lo | (hi << 8);
+}
+
+/* Returns true if the PIT raised an interrupt that is not yet
+   handled. */
+static bool
+pit_irq_pending (void) {
+	outb (0x20, 0x0a);    /* OCW3: read the master PIC's IRR. */
+	return inb (0x20) & 1;
+}
+
+/* Returns how many ticks from now may pass with no timer firing and
+   no wheel cascade, at most MAX.  The last of them is the one to wake
+   up on. */
+static int
+wheel_idle_ticks (int max) {
+	int n;
+
+	if (wheel.ticks <= ticks)
+		return 1;
+	for (n = 1; n < max; n++) {
+		int64_t tick = wheel.ticks + n - 1;
+		if ((tick & TVR_MASK) == 0 || !list_empty (&wheel.tv1[tick & TVR_MASK]))
+			break;
+	}
+	return n;
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t start = rdtsc ();
+	uint64_t cycles;
+	int n = 1;
+
+	// a one-shot fired: the ticks before the last were spent idle
+	if (oneshot_ticks > 0) {
+		n = oneshot_ticks;
+		oneshot_ticks = 0;
+		pit_program (PIT_PERIODIC, pit_count);
+	}
+	for (; n > 1; n--) {
+		ticks++;
+		thread_idle_tick ();
+		skipped_ticks++;
+	}
 	ticks++;
 	thread_tick ();
-	thread_wakeup(ticks);
+	timer_wheel_run (&wheel, ticks);
+
+	cycles = rdtsc () - start;
+	intr_cnt++;
+	intr_cycles += cycles;
+	if (cycles > intr_max_cycles)
+		intr_max_cycles = cycles;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -6,6 +6,7 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "filesys/fat.h"
+#include "filesys/page_cache.h"
 #include "threads/thread.h"
 #include <string.h>
 #include "filesys/inode.h"
@@ -38,7 +39,7 @@ dir_create (disk_sector_t sector, size_t entry_cnt, disk_sector_t parent_sector)
 	struct inode *inode = inode_open(sector);
 	// checking dir
 	inode->data.isdir = 1;
-	disk_write (filesys_disk, sector, &inode->data);
+	page_cache_write (sector, &inode->data);
 	struct dir_entry e;
 	off_t ofs;
 
@@ -356,7 +357,7 @@ bool symlink_change_dir(struct inode* inode) {
 	
 	/* chaining until finding target file */
 	while (sector) {
-		disk_read(filesys_disk, sector, target);
+		page_cache_read (sector, target);
 		void *file_entity = filesys_open(target);
 		if (!file_entity)
 			PANIC("No such file or directory");
@@ -366,7 +367,7 @@ bool symlink_change_dir(struct inode* inode) {
 			sector = dir->inode->data.start;
 		else {
 			sector = 0;
-			disk_write(filesys_disk, inode->sector, &dir->inode->data);
+			page_cache_write (inode->sector, &dir->inode->data);
 			memcpy(&inode->data, &dir->inode->data, sizeof(struct inode_disk)); 
 		}	
 
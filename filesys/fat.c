@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include "lib/round.h"
 #include "filesys/directory.h"
+#include "filesys/page_cache.h"
+#include <list.h>
 
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
@@ -17,13 +19,21 @@ struct fat_boot {
 	unsigned int root_dir_cluster;
 };
 
+/* Run of free clusters [start, start + len) */
+struct fat_extent {
+	cluster_t start;
+	cluster_t len;
+	struct list_elem elem;
+};
+
 /* FAT FS */
 struct fat_fs {
 	struct fat_boot bs;
 	unsigned int *fat;
 	unsigned int fat_length;	// counts of clusters
 	disk_sector_t data_start;	// sector where to start
-	cluster_t last_clst;
+	struct list free_extents;	// sorted by start, never adjacent
+	cluster_t free_cnt;			// free clusters in free_extents
 	struct lock write_lock;
 };
 
@@ -31,6 +41,9 @@ static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_extent_build (void);
+static void fat_extent_release (cluster_t start, cluster_t len);
+static cluster_t fat_extent_take (struct fat_extent *ext, cluster_t cnt);
 
 void
 fat_init (void) {
@@ -63,22 +76,24 @@ fat_open (void) {
 	off_t bytes_read = 0;
 	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
+	unsigned full = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	if (full > fat_fs->bs.fat_sectors)
+		full = fat_fs->bs.fat_sectors;
+
+	// whole sectors by one transfer, only the tail needs bounce
+	disk_read_multiple (filesys_disk, fat_fs->bs.fat_start, full, buffer);
+	bytes_read = full * DISK_SECTOR_SIZE;
+	for (unsigned i = full; i < fat_fs->bs.fat_sectors; i++) {
 		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
+		uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("FAT load failed");
+		disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
+		memcpy (buffer + bytes_read, bounce, bytes_left);
+		bytes_read += bytes_left;
+		free (bounce);
 	}
+	fat_extent_build ();
 }
 
 void
@@ -96,21 +111,22 @@ fat_close (void) {
 	off_t bytes_wrote = 0;
 	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
+	unsigned full = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	if (full > fat_fs->bs.fat_sectors)
+		full = fat_fs->bs.fat_sectors;
+
+	// whole sectors by one transfer, only the tail needs bounce
+	disk_write_multiple (filesys_disk, fat_fs->bs.fat_start, full, buffer);
+	bytes_wrote = full * DISK_SECTOR_SIZE;
+	for (unsigned i = full; i < fat_fs->bs.fat_sectors; i++) {
 		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
+		bounce = calloc (1, DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("FAT close failed");
+		memcpy (bounce, buffer + bytes_wrote, bytes_left);
+		disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
+		bytes_wrote += bytes_left;
+		free (bounce);
 	}
 }
 
@@ -124,6 +140,7 @@ fat_create (void) {
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_extent_build ();
 
 	// Set up ROOT_DIR_CLST
 	// fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -131,7 +148,7 @@ fat_create (void) {
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	page_cache_write (cluster_to_sector (ROOT_DIR_CLUSTER), buf);
 	free (buf);
 }
 
@@ -156,11 +173,87 @@ void
 fat_fs_init (void) {
 	/* TODO: Your code goes here. */
 	lock_init(&fat_fs->write_lock);	
+	list_init(&fat_fs->free_extents);
+	fat_fs->free_cnt = 0;
 	// round up clusters 
 	fat_fs->fat_length = (fat_fs->bs.total_sectors - 1) *  DISK_SECTOR_SIZE 
 							/ (DISK_SECTOR_SIZE + sizeof(cluster_t) * SECTORS_PER_CLUSTER) - 2;
 	fat_fs->data_start = fat_fs->bs.fat_start + (fat_fs->fat_length * sizeof(cluster_t)) / DISK_SECTOR_SIZE + 1;
-	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
+}
+
+/* fat table을 한번 훑어서 free cluster들의 extent list를 새로 만듦
+ * ROOT_DIR_CLUSTER는 fat 값과 상관없이 항상 사용중으로 취급 */
+static void
+fat_extent_build (void) {
+	while (!list_empty(&fat_fs->free_extents))
+		free(list_entry(list_pop_front(&fat_fs->free_extents), struct fat_extent, elem));
+	fat_fs->free_cnt = 0;
+
+	cluster_t clst = ROOT_DIR_CLUSTER + 1;
+	while (clst <= fat_fs->fat_length) {
+		if (fat_fs->fat[clst-1]) {
+			clst++;
+			continue;
+		}
+		cluster_t start = clst;
+		while (clst <= fat_fs->fat_length && !fat_fs->fat[clst-1])
+			clst++;
+		fat_extent_release(start, clst - start);
+	}
+}
+
+/* [start, start + len)을 free extent list에 넣고 이웃한 extent와 병합
+ * extent를 할당하지 못하면 해당 cluster는 다음 mount까지 사용하지 않음
+ * write_lock을 잡은 상태로 호출 */
+static void
+fat_extent_release (cluster_t start, cluster_t len) {
+	struct list_elem *e;
+	struct fat_extent *prev = NULL, *next = NULL;
+
+	for (e = list_begin(&fat_fs->free_extents); e != list_end(&fat_fs->free_extents); e = list_next(e)) {
+		next = list_entry(e, struct fat_extent, elem);
+		if (next->start > start)
+			break;
+		prev = next;
+		next = NULL;
+	}
+
+	if (prev && prev->start + prev->len == start) {
+		prev->len += len;
+		if (next && prev->start + prev->len == next->start) {
+			prev->len += next->len;
+			list_remove(&next->elem);
+			free(next);
+		}
+	} else if (next && start + len == next->start) {
+		next->start = start;
+		next->len += len;
+	} else {
+		struct fat_extent *ext = malloc(sizeof(struct fat_extent));
+		if (!ext)
+			return;
+		ext->start = start;
+		ext->len = len;
+		list_insert(e, &ext->elem);
+	}
+	fat_fs->free_cnt += len;
+}
+
+/* ext의 앞쪽에서 최대 cnt개의 cluster를 떼어내고 시작 cluster return
+ * write_lock을 잡은 상태로 호출 */
+static cluster_t
+fat_extent_take (struct fat_extent *ext, cluster_t cnt) {
+	cluster_t start = ext->start;
+	if (cnt >= ext->len) {
+		cnt = ext->len;
+		list_remove(&ext->elem);
+		free(ext);
+	} else {
+		ext->start += cnt;
+		ext->len -= cnt;
+	}
+	fat_fs->free_cnt -= cnt;
+	return start;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -173,28 +266,54 @@ fat_fs_init (void) {
 cluster_t
 fat_create_chain (cluster_t clst) {
 	/* TODO: Your code goes here. */
+	return fat_create_chain_n(clst, 1);
+}
+
+/* CNT개의 cluster를 한번에 할당해서 CLST 뒤에 이어붙임, CLST가 0이면 새 chain
+ * CLST 바로 뒤의 extent나 CNT개가 들어가는 가장 앞의 extent를 우선 사용하고
+ * 없으면 앞쪽 extent부터 나눠서 할당
+ * 새 chain의 첫 cluster return, 공간이 부족하면 아무것도 할당하지 않고 0 return */
+cluster_t
+fat_create_chain_n (cluster_t clst, cluster_t cnt) {
 	ASSERT(clst != EOChain);
+	ASSERT(cnt > 0);
 	lock_acquire(&fat_fs->write_lock);
-	// search next-fit area
-	cluster_t s_clst = fat_fs->last_clst;
-	while (fat_fs->fat[s_clst-1]) {
-		if (++s_clst > fat_fs->fat_length)
-			s_clst = ROOT_DIR_CLUSTER + 0;
-
-		// fail to alloc
-		if (s_clst == fat_fs->last_clst - 1) {
-			lock_release(&fat_fs->write_lock);
-			return 0;
-		}			
+	if (fat_fs->free_cnt < cnt) {
+		lock_release(&fat_fs->write_lock);
+		return 0;
 	}
 
-	// append chain
-	fat_fs->last_clst = s_clst;
-	if (clst)
-		fat_fs->fat[clst-1] = s_clst;
-	fat_fs->fat[s_clst-1] = EOChain;
+	cluster_t first = 0, tail = clst;
+	while (cnt > 0) {
+		struct list_elem *e;
+		struct fat_extent *ext = NULL;
+		for (e = list_begin(&fat_fs->free_extents); e != list_end(&fat_fs->free_extents); e = list_next(e)) {
+			struct fat_extent *cand = list_entry(e, struct fat_extent, elem);
+			if (tail && cand->start == tail + 1) {	// contiguous to chain
+				ext = cand;
+				break;
+			}
+			if (!ext && cand->len >= cnt)
+				ext = cand;
+		}
+		if (!ext)
+			ext = list_entry(list_begin(&fat_fs->free_extents), struct fat_extent, elem);
+
+		// link taken run behind tail
+		cluster_t run = ext->len < cnt ? ext->len : cnt;
+		cluster_t s_clst = fat_extent_take(ext, run);
+		if (tail)
+			fat_fs->fat[tail-1] = s_clst;
+		for (cluster_t i = 0; i < run - 1; i++)
+			fat_fs->fat[s_clst+i-1] = s_clst + i + 1;
+		tail = s_clst + run - 1;
+		fat_fs->fat[tail-1] = EOChain;
+		if (!first)
+			first = s_clst;
+		cnt -= run;
+	}
 	lock_release(&fat_fs->write_lock);
-	return s_clst;
+	return first;
 }
 
 /* Remove the chain of clusters starting from CLST.
@@ -204,25 +323,32 @@ fat_remove_chain (cluster_t clst, cluster_t pclst) {
 	/* TODO: Your code goes here. */
 	ASSERT(clst != EOChain && clst);
 	lock_acquire(&fat_fs->write_lock);
-	fat_fs->last_clst = clst;
 	if (pclst) 
 		fat_fs->fat[pclst-1] = EOChain;
 	else {
 		fat_fs->fat[clst-1] = 0;
+		fat_extent_release(clst, 1);
 		return lock_release(&fat_fs->write_lock);
 	}
-		
 
-	// clean up chain
-	cluster_t temp = clst;
+	// clean up chain, release contiguous runs at once
+	cluster_t temp, start = clst, len = 0;
 	do {
 		temp = fat_fs->fat[clst-1];
 		fat_fs->fat[clst-1] = 0;
+		if (clst != start + len) {
+			fat_extent_release(start, len);
+			start = clst;
+			len = 0;
+		}
+		len++;
 	} while ((clst = temp) != EOChain);
+	fat_extent_release(start, len);
 	lock_release(&fat_fs->write_lock);
 }
 
-/* Update a value in the FAT table. */
+/* Update a value in the FAT table.
+ * free extent list는 갱신하지 않으므로 할당된 cluster에만 사용 */
 void
 fat_put (cluster_t clst, cluster_t val) {
 	/* TODO: Your code goes here. */
@@ -1,8 +1,11 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "devices/disk.h"
 #include "threads/malloc.h"
 
+static void file_readahead (struct file *file, off_t ofs, off_t bytes_read);
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -13,6 +16,8 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ra_pos = file->ra_end = 0;
+		file->ra_window = 0;
 		return file;
 	} else {
 		inode_close (inode);
@@ -65,6 +70,7 @@ file_get_inode (struct file *file) {
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	file_readahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -76,7 +82,43 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	file_readahead (file, file_ofs, bytes_read);
+	return bytes_read;
+}
+
+/* 이전 read가 끝난 위치부터 읽는 경우 sequential로 보고 window를 2배로 키움,
+ * 다른 위치를 읽으면 window를 0으로 줄임.
+ * window만큼 뒤의 sector들을 background에서 buffer cache로 미리 읽도록 요청 */
+static void
+file_readahead (struct file *file, off_t ofs, off_t bytes_read) {
+	off_t end = ofs + bytes_read;
+
+	if (bytes_read <= 0)
+		return;
+
+	if (ofs == file->ra_pos) {
+		file->ra_window = file->ra_window ? file->ra_window * 2 : RA_INIT_WINDOW;
+		if (file->ra_window > RA_MAX_WINDOW)
+			file->ra_window = RA_MAX_WINDOW;
+	} else {
+		file->ra_window = 0;
+		file->ra_end = end;
+	}
+	file->ra_pos = end;
+
+	if (file->ra_window == 0)
+		return;
+
+	// request only sectors which are not requested yet
+	off_t ra_start = (file->ra_end > end) ? file->ra_end : end;
+	off_t ra_end = end + file->ra_window * DISK_SECTOR_SIZE;
+	if (ra_start >= ra_end)
+		return;
+#ifdef EFILESYS
+	inode_readahead (file->inode, ra_start, ra_end - ra_start);
+#endif
+	file->ra_end = ra_end;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
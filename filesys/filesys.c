@@ -7,6 +7,9 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
+#ifdef EFILESYS
+#include "filesys/page_cache.h"
+#endif
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -24,6 +27,7 @@ filesys_init (bool format) {
 	inode_init ();
 
 #ifdef EFILESYS
+	page_cache_init ();
 	fat_init ();
 
 	if (format)
@@ -47,6 +51,7 @@ void
 filesys_done (void) {
 	/* Original FS */
 #ifdef EFILESYS
+	page_cache_flush ();
 	fat_close ();
 #else
 	free_map_close ();
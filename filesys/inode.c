@@ -8,6 +8,9 @@
 #include "threads/malloc.h"
 #include "filesys/fat.h"
 #include "userprog/syscall.h"
+#ifdef EFILESYS
+#include "filesys/page_cache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -60,7 +63,15 @@ inode_open (disk_sector_t sector) {
 	inode->cwd_cnt = 0;
 	inode->removed = false;
 	lock_init(&inode->w_lock);
+	lock_init(&inode->map_lock);
+	inode->clst_map = NULL;
+	inode->map_cnt = inode->map_cap = 0;
+	inode->map_start = 0;
+#ifdef EFILESYS
+	page_cache_read (inode->sector, &inode->data);
+#else
 	disk_read (filesys_disk, inode->sector, &inode->data);
+#endif
 	return inode;
 }
 
@@ -153,6 +164,7 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
+		free (inode->clst_map);
 		free (inode); 
 	}
 }
@@ -308,41 +320,97 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
 #include "include/filesys/fat.h"
 
+/* clst_map이 IDX + 1개 이상의 cluster를 담을 수 있도록 늘림, 실패하면 false */
+static bool
+clst_map_reserve (struct inode *inode, size_t idx) {
+	if (idx < inode->map_cap)
+		return true;
+
+	size_t cap = inode->map_cap ? inode->map_cap * 2 : 16;
+	while (cap <= idx)
+		cap *= 2;
+	cluster_t *map = realloc (inode->clst_map, cap * sizeof (cluster_t));
+	if (map == NULL)
+		return false;
+	inode->clst_map = map;
+	inode->map_cap = cap;
+	return true;
+}
+
+/* inode의 IDX번째 sector의 cluster return, chain이 짧으면 0 return.
+ * 한번 따라간 chain은 clst_map에 기록해두고 이어서 따라가기 때문에
+ * 같은 inode에 대해서는 chain을 처음부터 다시 순회하지 않음 */
+static cluster_t
+idx_to_cluster (struct inode *inode, size_t idx) {
+	cluster_t clst, next;
+	lock_acquire(&inode->map_lock);
+
+	// start is changed by symlink or first growth
+	if (inode->map_start != inode->data.start)
+		inode->map_cnt = 0;
+
+	if (inode->map_cnt == 0) {
+		inode->map_start = inode->data.start;
+		if (clst_map_reserve(inode, 0)) {
+			inode->clst_map[0] = sector_to_cluster(inode->data.start);
+			inode->map_cnt = 1;
+		}
+	}
+
+	if (inode->map_cnt == 0) {	// oom, walk from start
+		clst = sector_to_cluster(inode->data.start);
+		while (clst && idx--)
+			clst = ((next = fat_get(clst)) == EOChain) ? 0 : next;
+		lock_release(&inode->map_lock);
+		return clst;
+	}
+
+	clst = inode->clst_map[inode->map_cnt - 1];
+	while (clst && inode->map_cnt <= idx) {
+		clst = ((next = fat_get(clst)) == EOChain) ? 0 : next;
+		if (clst && clst_map_reserve(inode, inode->map_cnt))
+			inode->clst_map[inode->map_cnt++] = clst;
+		else if (clst) {	// oom, walk rest of chain without recording
+			idx -= inode->map_cnt;
+			while (clst && idx--)
+				clst = ((next = fat_get(clst)) == EOChain) ? 0 : next;
+			lock_release(&inode->map_lock);
+			return clst;
+		}
+	}
+	if (clst)
+		clst = inode->clst_map[idx];
+	lock_release(&inode->map_lock);
+	return clst;
+}
+
 /* inode의 offset위치에 해당하는 sector return 실패하면 -1 return. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 	ASSERT(inode->data.magic == INODE_MAGIC);
 	ASSERT (inode != NULL);
 	if (pos > inode->data.length)
 		return -1;
 
-	cluster_t clst;
-	int sector_cnt = pos / DISK_SECTOR_SIZE;
-	clst = sector_to_cluster(inode->data.start);
-	while (sector_cnt-- > 0) 
-		clst = fat_get(clst);
-
-	if (sector_cnt > 0)
+	cluster_t clst = idx_to_cluster(inode, pos / DISK_SECTOR_SIZE);
+	if (!clst)
 		return -1;
 
 	return cluster_to_sector(clst);
 }
 
-/* inode의 offset위치에 해당하는 sector return 실패하면 -1 return. */
+/* inode의 offset위치에 해당하는 sector return 실패하면 -1 return.
+ * sector 경계에 있는 offset은 이전 sector를 return */
 static disk_sector_t
-byte_to_sector2 (const struct inode *inode, off_t pos) {
+byte_to_sector2 (struct inode *inode, off_t pos) {
 	ASSERT(inode->data.magic == INODE_MAGIC);
 	ASSERT (inode != NULL);
 	if (pos > inode->data.length)
 		return -1;
 
-	cluster_t clst;
 	int sector_cnt = pos / DISK_SECTOR_SIZE - (pos % DISK_SECTOR_SIZE == 0);
-	clst = sector_to_cluster(inode->data.start);
-	while (sector_cnt-- > 0) 
-		clst = fat_get(clst);
-
-	if (sector_cnt > 0)
+	cluster_t clst = idx_to_cluster(inode, sector_cnt > 0 ? sector_cnt : 0);
+	if (!clst)
 		return -1;
 
 	return cluster_to_sector(clst);
@@ -365,10 +433,11 @@ inode_close (struct inode *inode) {
 		/* Deallocate blocks if removed. 
 			only target file can delete disk */
 		if (inode->removed && (inode->sector == inode->data.target_sector)) {
-			disk_write(filesys_disk, inode->sector, &inode->data);
+			page_cache_write (inode->sector, &inode->data);
 			fat_remove_chain(sector_to_cluster(inode->sector), 0);
 		}
 			
+		free (inode->clst_map);
 		free (inode); 
 	}
 }
@@ -397,10 +466,7 @@ inode_create (disk_sector_t sector, off_t length) {
 		int create_cnt = bytes_to_sectors(length);
 		s_clst = clst = sector_to_cluster(sector);
 		
-		while (clst && create_cnt--) 
-			clst = fat_create_chain(clst);
-
-		if (create_cnt > 0 || !clst) {	// if fail to create chain
+		if (create_cnt > 0 && !fat_create_chain_n(clst, create_cnt)) {	// if fail to create chain
 			fat_remove_chain(s_clst, 0);
 			return false;
 		}
@@ -414,11 +480,11 @@ inode_create (disk_sector_t sector, off_t length) {
 		disk_inode->length = length;
 		disk_inode->target_sector = sector;
 		disk_inode->magic = INODE_MAGIC;
-		disk_write (filesys_disk, sector, disk_inode);
+		page_cache_write (sector, disk_inode);
 		
 		// memset 0 on disk
 		while ((s_clst = fat_get(s_clst)) != EOChain) 
-			disk_write (filesys_disk, disk_inode->start, zeros);
+			page_cache_write (cluster_to_sector(s_clst), zeros);
 		
 		free (disk_inode);
 	}
@@ -433,7 +499,6 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	off_t origin_size = size, origin_offset = offset;
 	cluster_t clst;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 	uint8_t *buffer = buffer_;
 	if (inode->w_lock.holder) {
 		lock_acquire(&inode->w_lock);
@@ -456,20 +521,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		/* Copy out of the cached sector. */
+		page_cache_read_at (sector_idx, buffer + bytes_read, chunk_size, sector_ofs);
 
 		/* Advance. */
 		size -= chunk_size;
@@ -481,7 +534,6 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 		sector_idx = cluster_to_sector(clst);
 	}
-	free (bounce);
 	
 	return bytes_read;
 }
@@ -502,7 +554,6 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
 		return 0;
 
 	cluster_t clst;
-	uint8_t *bounce = NULL;
 	const uint8_t *buffer = buffer_;
 	disk_sector_t sector_idx = file_growth(inode, size, offset);
 	off_t bytes_written = 0, len = inode_length(inode);
@@ -521,27 +572,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else { 
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* Write into the cached sector, flushed to disk later. */
+		page_cache_write_at (sector_idx, buffer + bytes_written, chunk_size, sector_ofs);
 
 		/* Advance. */
 		size -= chunk_size;
@@ -554,10 +586,32 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
 			break;
 		sector_idx = cluster_to_sector(clst);
 	}
-	free (bounce);
 	return bytes_written;
 }
 
+/* OFFSET부터 SIZE byte에 해당하는 sector들을 background에서 buffer cache로 읽도록 요청 */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t size) {
+	ASSERT(inode->data.magic == INODE_MAGIC);
+	cluster_t clst;
+	off_t len = inode_length (inode);
+	if (offset >= len || size <= 0)
+		return;
+	if (offset + size > len)
+		size = len - offset;
+
+	int sector_cnt = DIV_ROUND_UP (offset % DISK_SECTOR_SIZE + size, DISK_SECTOR_SIZE);
+	disk_sector_t sector_idx = byte_to_sector (inode, offset);
+	while (sector_cnt--) {
+		page_cache_prefetch (sector_idx);
+
+		// find next sector
+		if (!sector_cnt || (clst = fat_get(sector_to_cluster(sector_idx))) == EOChain)
+			break;
+		sector_idx = cluster_to_sector(clst);
+	}
+}
+
 disk_sector_t file_growth(struct inode *inode, off_t size, off_t offset) {
 	disk_sector_t sector, sector_idx;
 	cluster_t clst, last_clst, off_clst;
@@ -580,15 +634,8 @@ disk_sector_t file_growth(struct inode *inode, off_t size, off_t offset) {
 			}
 		}
 		
-		// append cluster chain 
-		while (clst && create_cnt--) 
-			clst = fat_create_chain(clst);
-		
-		if (create_cnt > 0 || !clst) {
-			if (inode->data.length != 0)	// case 2
-				fat_remove_chain(fat_get(last_clst), last_clst);
-			else if (fat_get(last_clst) != EOChain)	// case 1, only created chain  
-				fat_remove_chain(fat_get(last_clst), last_clst);
+		// append cluster chain, nothing is allocated on failure
+		if (create_cnt > 0 && !fat_create_chain_n(clst, create_cnt)) {
 			lock_release(&inode->w_lock);
 			return false;
 		}
@@ -599,7 +646,7 @@ disk_sector_t file_growth(struct inode *inode, off_t size, off_t offset) {
 
 		// update inode struct on disk
 		inode->data.length += add_length;
-		disk_write (filesys_disk, inode->data.target_sector, &inode->data);
+		page_cache_write (inode->data.target_sector, &inode->data);
 		sector_idx = byte_to_sector(inode, offset);	
 
 		// memset 0 until offset_sector from last_clst behind on disk
@@ -608,17 +655,17 @@ disk_sector_t file_growth(struct inode *inode, off_t size, off_t offset) {
 		clst = last_clst;
 		while (clst != off_clst) {
 			clst = fat_get(clst);
-			disk_write (filesys_disk, cluster_to_sector(clst), zeros);	
+			page_cache_write (cluster_to_sector(clst), zeros);	
 		}
 		if (last_clst != off_clst)	// careful not to overlap last sector
-			disk_write (filesys_disk, cluster_to_sector(off_clst), zeros);	
+			page_cache_write (cluster_to_sector(off_clst), zeros);	
 		lock_release(&inode->w_lock);	
 		
 	} else {
 		if (add_length > 0) {
 			// update inode struct on disk (not append sector)
 			inode->data.length += add_length;
-			disk_write (filesys_disk, inode->data.target_sector, &inode->data);
+			page_cache_write (inode->data.target_sector, &inode->data);
 		}
 		sector_idx = byte_to_sector(inode, offset);
 	}
@@ -636,7 +683,7 @@ bool symlink_change_file(struct inode* inode) {
 	
 	/* chaining until finding target file */
 	while (sector) {
-		disk_read(filesys_disk, sector, target);
+		page_cache_read (sector, target);
 		void *file_entity = filesys_open(target);
 		if (!file_entity)
 			PANIC("No such file or directory");
@@ -662,6 +709,6 @@ void file_change_symlink(struct inode* inode) {
 	if (inode->sector == inode->data.target_sector)
 		return;
 	
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	page_cache_read (inode->sector, &inode->data);
 }
 #endif
\ No newline at end of file
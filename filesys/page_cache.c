@@ -1,9 +1,20 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include <stdio.h>
+#include <string.h>
+#include "filesys/page_cache.h"
+#include "filesys/filesys.h"
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/malloc.h"
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
+static void page_cache_kworkerd (void *aux);
+static void page_cache_readaheadd (void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations page_cache_op = {
@@ -14,38 +25,301 @@ static const struct page_operations page_cache_op = {
 };
 
 tid_t page_cache_workerd;
+tid_t page_cache_readahead_workerd;
+
+static struct cache_table ctb;
+static struct readahead_queue raq;
+
+static struct cache_entry *cache_lookup (disk_sector_t sector, bool load);
+static struct cache_entry *cache_find (disk_sector_t sector);
+static struct cache_entry *cache_install (disk_sector_t sector);
+static struct cache_entry *cache_get_victim (void);
+static void cache_writeback (struct cache_entry *e);
+static uint64_t cache_hash (const struct hash_elem *e_, void *aux);
+static bool cache_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux);
+
+/* sector cache 초기화, entry마다 sector 크기의 buffer를 page에서 잘라서 할당 */
+void
+page_cache_init (void) {
+	size_t pg_cnt = PAGE_CACHE_SIZE * DISK_SECTOR_SIZE / PGSIZE;
+	uint8_t *buf = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, pg_cnt);
+
+	hash_init (&ctb.sectors, cache_hash, cache_less, NULL);
+	lock_init (&ctb.pc_lock);
+	for (int i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = &ctb.entries[i];
+		e->valid = e->dirty = e->accessed = false;
+		e->kva = buf + i * DISK_SECTOR_SIZE;
+	}
+	ctb.clock_hand = 0;
+	ctb.hit_cnt = ctb.miss_cnt = 0;
+	ctb.write_seq = 0;
+
+	raq.head = raq.tail = 0;
+	lock_init (&raq.ra_lock);
+	sema_init (&raq.ra_sema, 0);
+	raq.bounce = malloc (READAHEAD_BATCH * DISK_SECTOR_SIZE);
+	if (raq.bounce == NULL)
+		PANIC ("page cache init failed");
+}
 
 /* The initializer of file vm */
 void
 pagecache_init (void) {
 	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
-	thread_create("page_cache_workerd", PRI_DEFAULT, page_cache_kworkerd, NULL);
+	page_cache_workerd = thread_create("page_cache_workerd", PRI_DEFAULT, page_cache_kworkerd, NULL);
+	page_cache_readahead_workerd = thread_create("readahead_workerd", PRI_DEFAULT, page_cache_readaheadd, NULL);
 }
 
 /* Initialize the page cache */
 bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
+page_cache_initializer (struct page *page, enum vm_type type UNUSED, void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
-
+	return true;
 }
 
 /* Utilze the Swap in mechanism to implement readhead */
 static bool
 page_cache_readahead (struct page *page, void *kva) {
+	disk_sector_t sector = page->page_cache.sector;
+	for (size_t readb = 0; readb < PGSIZE; readb += DISK_SECTOR_SIZE)
+		page_cache_read (sector++, kva + readb);
+	return true;
 }
 
 /* Utilze the Swap out mechanism to implement writeback */
 static bool
 page_cache_writeback (struct page *page) {
+	disk_sector_t sector = page->page_cache.sector;
+	for (size_t writeb = 0; writeb < PGSIZE; writeb += DISK_SECTOR_SIZE)
+		page_cache_write (sector++, page->frame->kva + writeb);
+	return true;
 }
 
 /* Destory the page_cache. */
 static void
-page_cache_destroy (struct page *page) {
+page_cache_destroy (struct page *page UNUSED) {
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache, 주기적으로 dirty sector를 disk에 기록 */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (PAGE_CACHE_FLUSH_INTERVAL);
+		page_cache_flush ();
+	}
+}
+
+/* Read-ahead worker, queue에 들어온 sector를 buffer cache로 읽어옴
+ * 연속된 sector들은 최대 READAHEAD_BATCH개까지 묶어서 한번에 읽음
+ * disk를 읽는 동안 pc_lock을 잡지 않아서 다른 thread의 cache hit를 막지 않음 */
+static void
+page_cache_readaheadd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&raq.ra_sema);
+		lock_acquire (&raq.ra_lock);
+		disk_sector_t sector = raq.sectors[raq.head];
+		raq.head = (raq.head + 1) % READAHEAD_QUEUE_SIZE;
+		size_t cnt = 1;
+		while (cnt < READAHEAD_BATCH && raq.head != raq.tail
+				&& raq.sectors[raq.head] == sector + cnt
+				&& sema_try_down (&raq.ra_sema)) {
+			raq.head = (raq.head + 1) % READAHEAD_QUEUE_SIZE;
+			cnt++;
+		}
+		lock_release (&raq.ra_lock);
+
+		// trim cached sectors on both ends of the run
+		lock_acquire (&ctb.pc_lock);
+		while (cnt > 0 && cache_find (sector) != NULL) {
+			sector++;
+			cnt--;
+		}
+		while (cnt > 0 && cache_find (sector + cnt - 1) != NULL)
+			cnt--;
+		long long write_seq = ctb.write_seq;
+		lock_release (&ctb.pc_lock);
+		if (cnt == 0)
+			continue;
+
+		disk_read_multiple (filesys_disk, sector, cnt, raq.bounce);
+
+		// sector가 그 사이에 cache에 올라왔거나 기록된 경우 읽은 내용을 버림
+		lock_acquire (&ctb.pc_lock);
+		for (size_t i = 0; i < cnt && write_seq == ctb.write_seq; i++) {
+			if (cache_find (sector + i) != NULL)
+				continue;
+			struct cache_entry *e = cache_install (sector + i);
+			memcpy (e->kva, raq.bounce + i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+			e->accessed = false;		// evict first if never used
+			ctb.miss_cnt++;
+		}
+		lock_release (&ctb.pc_lock);
+	}
+}
+
+/* SECTOR를 background에서 cache로 읽도록 요청, queue가 가득 차면 무시 */
+void
+page_cache_prefetch (disk_sector_t sector) {
+	lock_acquire (&raq.ra_lock);
+	size_t next = (raq.tail + 1) % READAHEAD_QUEUE_SIZE;
+	if (next != raq.head) {
+		raq.sectors[raq.tail] = sector;
+		raq.tail = next;
+		sema_up (&raq.ra_sema);
+	}
+	lock_release (&raq.ra_lock);
+}
+
+/* SECTOR 전체를 BUFFER로 읽음 */
+void
+page_cache_read (disk_sector_t sector, void *buffer) {
+	page_cache_read_at (sector, buffer, DISK_SECTOR_SIZE, 0);
+}
+
+/* BUFFER를 SECTOR 전체에 기록 */
+void
+page_cache_write (disk_sector_t sector, const void *buffer) {
+	page_cache_write_at (sector, buffer, DISK_SECTOR_SIZE, 0);
+}
+
+/* SECTOR의 OFS부터 SIZE byte를 BUFFER로 읽음, miss인 경우만 disk에서 읽음 */
+void
+page_cache_read_at (disk_sector_t sector, void *buffer, off_t size, off_t ofs) {
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&ctb.pc_lock);
+	struct cache_entry *e = cache_lookup (sector, true);
+	memcpy (buffer, e->kva + ofs, size);
+	lock_release (&ctb.pc_lock);
+}
+
+/* BUFFER의 SIZE byte를 SECTOR의 OFS부터 기록, disk 기록은 evict나 flush때 수행
+ * sector 전체를 덮어쓰는 경우 disk에서 읽지 않음 */
+void
+page_cache_write_at (disk_sector_t sector, const void *buffer, off_t size, off_t ofs) {
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&ctb.pc_lock);
+	bool whole = (ofs == 0 && size == DISK_SECTOR_SIZE);
+	struct cache_entry *e = cache_lookup (sector, !whole);
+	memcpy (e->kva + ofs, buffer, size);
+	e->dirty = true;
+	ctb.write_seq++;
+	lock_release (&ctb.pc_lock);
+}
+
+/* dirty인 sector 전부 disk에 기록
+ * 한번에 queue에 넣어서 disk 순서대로 정렬되고 인접한 sector는 합쳐서 기록됨 */
+void
+page_cache_flush (void) {
+	size_t req_cnt = 0;
+
+	lock_acquire (&ctb.pc_lock);
+	for (int i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = &ctb.entries[i];
+		if (e->valid && e->dirty) {
+			struct disk_request *req = &ctb.flush_reqs[req_cnt++];
+			disk_request_init (req, filesys_disk, e->sector, 1, e->kva, true);
+			disk_submit (req, NULL, NULL);
+			e->dirty = false;
+		}
+	}
+	for (size_t i = 0; i < req_cnt; i++)
+		disk_wait (&ctb.flush_reqs[i]);
+	lock_release (&ctb.pc_lock);
+}
+
+/* Prints page cache statistics. */
+void
+page_cache_print_stats (void) {
+	printf ("Page cache: %lld hits, %lld misses\n", ctb.hit_cnt, ctb.miss_cnt);
+}
+
+/* SECTOR에 해당하는 entry return, 없으면 victim을 골라 교체
+ * LOAD가 true면 disk에서 sector를 읽어옴, pc_lock을 잡은 상태로 호출 */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector, bool load) {
+	struct cache_entry *e;
+
+	ASSERT (lock_held_by_current_thread (&ctb.pc_lock));
+	if ((e = cache_find (sector)) != NULL) {
+		e->accessed = true;
+		ctb.hit_cnt++;
+		return e;
+	}
+
+	ctb.miss_cnt++;
+	e = cache_install (sector);
+	if (load)
+		disk_read (filesys_disk, sector, e->kva);
+	return e;
+}
+
+/* SECTOR를 가진 entry return, 없으면 NULL */
+static struct cache_entry *
+cache_find (disk_sector_t sector) {
+	struct cache_entry label;
+	struct hash_elem *find_e;
+
+	label.sector = sector;
+	find_e = hash_find (&ctb.sectors, &label.hash_elem);
+	return (find_e != NULL) ? hash_entry (find_e, struct cache_entry, hash_elem) : NULL;
+}
+
+/* victim entry를 SECTOR용으로 교체하여 return, 내용은 caller가 채움 */
+static struct cache_entry *
+cache_install (disk_sector_t sector) {
+	struct cache_entry *e = cache_get_victim ();
+	if (e->valid)
+		hash_delete (&ctb.sectors, &e->hash_elem);
+
+	e->sector = sector;
+	e->valid = true;
+	e->dirty = false;
+	e->accessed = true;
+	hash_insert (&ctb.sectors, &e->hash_elem);
+	return e;
+}
+
+/* clock algorithm으로 교체할 entry를 골라 dirty면 disk에 기록 후 return */
+static struct cache_entry *
+cache_get_victim (void) {
+	struct cache_entry *victim = NULL;
+	while (victim == NULL) {
+		struct cache_entry *e = &ctb.entries[ctb.clock_hand];
+		ctb.clock_hand = (ctb.clock_hand + 1) % PAGE_CACHE_SIZE;
+
+		if (!e->valid || !e->accessed)
+			victim = e;
+		else
+			e->accessed = false;
+	}
+	cache_writeback (victim);
+	return victim;
+}
+
+/* entry가 dirty면 disk에 기록 */
+static void
+cache_writeback (struct cache_entry *e) {
+	if (e->valid && e->dirty) {
+		disk_write (filesys_disk, e->sector, e->kva);
+		e->dirty = false;
+	}
+}
+
+/* sector cache hashing 하는 함수 */
+static uint64_t
+cache_hash (const struct hash_elem *e_, void *aux UNUSED) {
+	const struct cache_entry *e = hash_entry (e_, struct cache_entry, hash_elem);
+	return hash_bytes (&e->sector, sizeof e->sector);
+}
+
+/* Returns true if entry a precedes entry b. */
+static bool
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct cache_entry *a = hash_entry (a_, struct cache_entry, hash_elem);
+	const struct cache_entry *b = hash_entry (b_, struct cache_entry, hash_elem);
+	return a->sector < b->sector;
 }
@@ -2,7 +2,10 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,6 +18,33 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Maximum sectors moved by a single ATA READ/WRITE SECTOR command. */
+#define DISK_MULTIPLE_MAX 256
+
+/* Ticks a queued request may be passed over by the elevator. */
+#define DISK_DEADLINE_TICKS 50
+
+struct disk_request;
+typedef void disk_done_func (struct disk_request *, void *aux);
+
+/* An asynchronous transfer of CNT contiguous sectors.
+   Owned by the disk layer from disk_submit() until completion. */
+struct disk_request {
+	struct disk *disk;
+	disk_sector_t sec_no;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+	bool write;                 /* True: write BUFFER to disk. */
+
+	disk_done_func *done;       /* Called on completion, or NULL. */
+	void *aux;
+	struct semaphore complete;  /* Up'd on completion if DONE is NULL. */
+
+	int64_t deadline;           /* Served first after this tick. */
+	struct list_elem elem;      /* Channel queue, sorted by sector. */
+	struct list_elem fifo_elem; /* Channel queue, in submission order. */
+};
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,6 +52,13 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, size_t, void *);
+void disk_write_multiple (struct disk *, disk_sector_t, size_t, const void *);
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+		size_t cnt, void *buffer, bool write);
+void disk_submit (struct disk_request *, disk_done_func *, void *aux);
+void disk_wait (struct disk_request *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -20,4 +22,46 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Kernel timers. */
+typedef void timer_func (void *aux);
+
+/* A one-shot timer.  Once the tick count reaches EXPIRES, FUNC is
+   called with AUX from the timer interrupt, so it must not sleep. */
+struct timer {
+	struct list_elem elem;      /* Element in a timer wheel slot. */
+	int64_t expires;            /* Tick to fire at. */
+	timer_func *func;           /* Called on expiry. */
+	void *aux;                  /* Passed to FUNC. */
+	bool armed;                 /* In the wheel, not yet fired. */
+};
+
+void timer_setup (struct timer *, timer_func *, void *aux);
+void timer_arm (struct timer *, int64_t expires);
+bool timer_cancel (struct timer *);
+
+/* Hierarchical timer wheel that the kernel timers live in.  Any
+   other wheel is driven by its owner, with its own notion of the
+   current tick.  timer_cancel works on timers of any wheel. */
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVN_LEVELS 3
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TIMER_WHEEL_SPAN ((int64_t) 1 << (TVR_BITS + TVN_LEVELS * TVN_BITS))
+
+struct timer_wheel {
+	struct list tv1[TVR_SIZE];              /* Next TVR_SIZE ticks. */
+	struct list tvn[TVN_LEVELS][TVN_SIZE];  /* Upper levels. */
+	int64_t ticks;                          /* Next tick whose level 0 slot runs. */
+};
+
+void timer_wheel_init (struct timer_wheel *, int64_t now);
+void timer_wheel_arm (struct timer_wheel *, struct timer *, int64_t expires);
+void timer_wheel_run (struct timer_wheel *, int64_t now);
+
 #endif /* devices/timer.h */
@@ -11,8 +11,14 @@ struct file
 	struct inode *inode; /* File's inode. */
 	off_t pos;			 /* Current position. */
 	bool deny_write;	 /* Has file_deny_write() been called? */
+	off_t ra_pos;		 /* Expected position of next sequential read. */
+	off_t ra_end;		 /* Read-ahead already requested up to here. */
+	int ra_window;		 /* Read-ahead window in sectors, 0: random access. */
 };
 
+#define RA_INIT_WINDOW 4	/* first window after sequential read detected */
+#define RA_MAX_WINDOW 32	/* max sectors fetched ahead */
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
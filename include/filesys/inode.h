@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 #include "devices/disk.h"
+#include "filesys/fat.h"
 #include "lib/kernel/list.h"
 #include "threads/synch.h"
 
@@ -25,6 +26,9 @@ off_t inode_length (const struct inode *);
 bool symlink_change_file(struct inode* inode);
 void file_change_symlink(struct inode* inode);
 
+/* for read-ahead */
+void inode_readahead (struct inode *inode, off_t offset, off_t size);
+
 /* for file growth */
 disk_sector_t file_growth(struct inode *inode, off_t size, off_t offset);
 
@@ -48,6 +52,11 @@ struct inode {
 	uint32_t deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	uint32_t cwd_cnt;						/* checking cwd */
 	struct lock w_lock;					/* for synchronization */
+	struct lock map_lock;				/* for clst_map */
+	cluster_t *clst_map;				/* cluster of each sector idx (FAT) */
+	size_t map_cnt;						/* recorded clusters in clst_map */
+	size_t map_cap;						/* allocated entries of clst_map */
+	disk_sector_t map_start;			/* data.start when clst_map recorded */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -1,14 +1,65 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
+#include "devices/disk.h"
+#include "filesys/off_t.h"
+
+/* struct page embeds this, so define it before vm.h is pulled in */
+struct page_cache {
+    disk_sector_t sector;
+};
+
 #include "vm/vm.h"
 
 struct page;
 enum vm_type;
 
-struct page_cache {
-    disk_sector_t sector;
+#define PAGE_CACHE_SIZE 64				/* Number of sectors kept in the cache */
+#define PAGE_CACHE_FLUSH_INTERVAL 100	/* ticks between kworkerd write-back */
+#define READAHEAD_QUEUE_SIZE 64			/* pending read-ahead sectors */
+#define READAHEAD_BATCH 8				/* max sectors read by one command */
+
+/* One cached sector of the filesys disk */
+struct cache_entry {
+	struct hash_elem hash_elem;		/* for sector hash */
+	disk_sector_t sector;			/* cached sector number */
+	bool valid;						/* holds a sector */
+	bool dirty;						/* need write-back */
+	bool accessed;					/* for clock algorithm */
+	uint8_t *kva;					/* DISK_SECTOR_SIZE bytes of data */
+};
+
+/* bounded sector cache, entries are evicted by clock algorithm */
+struct cache_table {
+	struct hash sectors;
+	struct cache_entry entries[PAGE_CACHE_SIZE];
+	size_t clock_hand;
+	struct lock pc_lock;
+	long long hit_cnt;
+	long long miss_cnt;
+	long long write_seq;			/* bumped on every write, for read-ahead */
+	struct disk_request flush_reqs[PAGE_CACHE_SIZE];	/* for flush */
+};
+
+/* sectors requested by read-ahead, consumed by page_cache_readaheadd */
+struct readahead_queue {
+	disk_sector_t sectors[READAHEAD_QUEUE_SIZE];
+	size_t head;
+	size_t tail;
+	struct lock ra_lock;
+	struct semaphore ra_sema;		/* count of queued sectors */
+	uint8_t *bounce;				/* read buffer of daemon */
 };
 
 void page_cache_init (void);
+void pagecache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+
+/* sector read & write through cache */
+void page_cache_read (disk_sector_t sector, void *buffer);
+void page_cache_write (disk_sector_t sector, const void *buffer);
+void page_cache_read_at (disk_sector_t sector, void *buffer, off_t size, off_t ofs);
+void page_cache_write_at (disk_sector_t sector, const void *buffer, off_t size, off_t ofs);
+void page_cache_flush (void);
+void page_cache_prefetch (disk_sector_t sector);
+void page_cache_print_stats (void);
 #endif
@@ -96,6 +96,7 @@ bool hash_empty (struct hash *);
 
 /* Sample hash functions. */
 uint64_t hash_bytes (const void *, size_t);
+void hash_bytes_128 (const void *, size_t, uint64_t hash[2]);
 uint64_t hash_string (const char *);
 uint64_t hash_int (int);
 
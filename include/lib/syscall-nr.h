@@ -36,6 +36,23 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra */
+	SYS_SPAWN,                  /* Create a process running a new program. */
+	SYS_MSYNC,                  /* Write back a range of a memory mapping. */
+	SYS_MADVISE,                /* Advise how a memory range will be used. */
 };
 
+/* Flags of msync. */
+#define MS_ASYNC 1                  /* Schedule write-back and return. */
+#define MS_SYNC 4                   /* Write back before returning. */
+
+/* Advice of madvise. */
+#define MADV_NORMAL 0               /* Default read-around and eviction. */
+#define MADV_RANDOM 1               /* No read-around. */
+#define MADV_SEQUENTIAL 2           /* Wide read-around, evict early. */
+#define MADV_WILLNEED 3             /* Read the range in now. */
+#define MADV_DONTNEED 4             /* Drop the range, reload on access. */
+#define MADV_HUGEPAGE 5             /* Map aligned 2 MiB chunks by huge pages. */
+
 #endif /* lib/syscall-nr.h */
@@ -5,6 +5,7 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "devices/timer.h"
 #include "threads/synch.h" /* for priority lock */
 
 #ifdef VM
@@ -151,30 +152,29 @@ struct thread
 	/* Owned by thread.c. */
 	struct intr_frame tf; /* Information for switching */
 	/* Alarm Clock */
-	int64_t wakeup_ticks; // 일어날 시각 추가
+	struct timer sleep_timer; // 일어날 시각에 만료되는 timer
 	/* Priority scheduling */
 	int init_priority;
+	int ready_priority;				/* 들어가 있는 ready queue의 priority */
 	struct lock *wait_on_lock;
 	struct list donations;			/* 이 스레드한테 도네이션 한 스레드들 목록 */
 	struct list_elem donation_elem; /* 다른 스레드한테 도네이션 했을때, 다른 스레드의 donations list에 들어갈 list_elem */
 	/* Advanced Scheduler */
 	int nice;
 	int recent_cpu;
-	struct list_elem thread_elem;
+	int cpu_epoch;					/* recent_cpu에 적용된 decay 횟수 */
 	unsigned magic; /* Detects stack overflow. */
 };
 
 /* for alaram-multiple */
 void thread_sleep(int64_t ticks);
-void thread_wakeup(int64_t current_ticks);
 
 /* for priority scheduling */
 typedef enum {
 	READY_LIST,
 	WAIT_LIST,
 	DONATION_LIST,
-	COND_LIST,
-	SLEEP_LIST
+	COND_LIST
 } typelist;
 void preempt_priority(void);
 bool priority_larger(const struct list_elem *insert_elem, const struct list_elem *cmp_elem, typelist type);
@@ -185,7 +185,7 @@ void thread_readylist_reorder(struct thread *t);
 void mlfq_scheduler(struct thread *t);
 void mlfq_cal_priority(struct thread *t);
 void thread_cal_load_avg(void);
-void thread_cal_recent_cpu(struct thread *t);
+void mlfq_refresh(struct thread *t);
 
 /* arithmetic cal */
 #define N_to_FP(n) ((n) * f)
@@ -209,6 +209,7 @@ void thread_init(void);
 void thread_start(void);
 
 void thread_tick(void);
+void thread_idle_tick(void);
 void thread_print_stats(void);
 
 typedef void thread_func(void *aux);
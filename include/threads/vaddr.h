@@ -31,6 +31,13 @@
 /* Round down to nearest page boundary. */
 #define pg_round_down(va) (void *) ((uint64_t) (va) & ~PGMASK)
 
+/* Huge page mapped by one page directory entry (bits 0:21). */
+#define HPGBITS 21                         /* Number of offset bits. */
+#define HPGSIZE (1 << HPGBITS)             /* Bytes in a huge page. */
+#define HPG_PAGES (HPGSIZE / PGSIZE)       /* Pages in a huge page. */
+#define hpg_ofs(va) ((uint64_t) (va) & (HPGSIZE - 1))
+#define hpg_round_down(va) (void *) ((uint64_t) (va) & ~(uint64_t) (HPGSIZE - 1))
+
 /* Kernel virtual address start */
 #define KERN_BASE LOADER_KERN_BASE
 
@@ -2,9 +2,13 @@
 #define USERPROG_PROCESS_H
 #include "threads/thread.h"
 #include "filesys/off_t.h"
+#include "devices/disk.h"
+#include "threads/vaddr.h"
 
+struct spawn_args;
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name);
+tid_t process_spawn (struct spawn_args *args);
 int process_exec (void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
@@ -18,12 +22,24 @@ bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
 						 bool writable);
 
 bool lazy_load_segment(struct page *page, void *aux);
+
+#define SPAWN_FD_MAX 16			/* fds passed to spawn at most */
+
+/* spawn에서 자식에게 넘겨주는 명령과 fd, 자식이 free */
+struct spawn_args
+{
+	char *fn_copy;						/* command line, palloc page */
+	struct dir *cwd;					/* reopened cwd of parent */
+	int fd_cnt;
+	int fds[SPAWN_FD_MAX];				/* fd number in child */
+	struct file *files[SPAWN_FD_MAX];	/* duplicated from parent */
+};
 struct lazy_load_data 
 {	
 	struct inode *inode;
-	size_t pg_cnt;
 	size_t ofs;
 	size_t readb;
+	uint64_t sector_hash[PGSIZE / DISK_SECTOR_SIZE][2];	// mmap page, as last read or written
 };
 
 
@@ -1,9 +1,16 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
+#include <stdbool.h>
+
+struct thread;
+struct file;
 
 void syscall_init (void);
 void check_address(void *addr);
 void syscall_entry(void);
+void exit(int status);
+bool install_fd(struct thread *t, int fd, struct file *file);
+void close_spawn_file(struct file *file);
 extern void *stdin_ptr;
 extern void *stdout_ptr;
 extern void *stderr_ptr;
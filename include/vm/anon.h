@@ -8,7 +8,19 @@ struct anon_page {
     disk_sector_t disk_sector;         // memorize swap out pos
 };
 
+#define SWAP_BATCH 8                   // max pages swapped out at once
+#define SWAP_READAROUND 4              // default pages read per swap in
+#define SWAP_READAROUND_MAX 16
+
+extern int swap_readaround;            // -swapra=N, 1 disables read-around
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+bool anon_swap_out_batch (struct page **pages, size_t cnt);
+void anon_prefetch_account (struct page *page);
+void anon_share_swap_slot (struct page *page);
+void anon_preclean (struct page **pages, size_t cnt);
+void anon_drop_swap_cache (struct page *page);
+void anon_print_stats (void);
 
 #endif
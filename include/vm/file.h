@@ -4,6 +4,7 @@
 #include "vm/vm.h"
 
 struct page;
+struct frame;
 enum vm_type;
 
 struct file_page {
@@ -12,6 +13,13 @@ struct file_page {
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+void file_backed_writeback (struct page *page);
+bool file_backed_load_huge (struct page *page, void *aux);
+struct lazy_load_data;
+void file_backed_hash_sectors (struct lazy_load_data *data, void *kva);
+bool file_backed_share_text (struct page *page);
+void file_backed_cache_text (struct page *page);
+size_t file_backed_release_frame (struct frame *frame, struct page *page);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
@@ -30,6 +30,10 @@ enum vm_type {
 	VM_ACCESS = (1<<8),
 	VM_NOSWAP = (1<<9),
 	VM_BSS = (1<<10),
+	VM_PREFETCH = (1<<11),		// swapped in by read-around, not yet used
+	VM_ZERO = (1<<12),			// mapped to shared zero frame, read only
+	VM_HUGE = (1<<13),			// HPGSIZE of mmap mapped by one pde, never evicted
+	VM_SWAPCACHE = (1<<14),		// anon in frame, anon.disk_sector holds a clean copy
 	/* DO NOT EXCEED THIS VALUE. */
 	VM_MARKER_END = (1 << 31),
 };
@@ -43,6 +47,7 @@ enum vm_type {
 
 struct page_operations;
 struct thread;
+struct vma;
 
 #define VM_TYPE(type) (type & 7)
 
@@ -58,8 +63,10 @@ struct page {
 	/* Your implementation */
 	enum vm_type type;					// check status
 	uint64_t *pml4;						// swap out
-	struct list_elem cp_elem;			// for copy 
+	struct list_elem rmap_elem;			// in frame's reverse map
 	struct hash_elem hash_elem;			// for spt
+	struct vma *vma;					// region made this page, NULL if stack
+	struct list_elem vma_elem;			// in vma's pages
 	
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -77,16 +84,37 @@ struct page {
  
 /* The representation of "frame" */
 struct frame {
-	struct hash_elem hash_elem;
+	struct list_elem elem;			// for ftb ring or free_frames
 	void *kva;
-	struct page *page;
+	struct page *page;				// first page of rmap, NULL if unused
+	bool pinned;					// being claimed or evicted, clock skips
+	struct list rmap;				// pages mapping this frame (cpwrite sharers)
+	size_t ref_cnt;					// length of rmap
+	struct lock rmap_lock;			// for rmap and ref_cnt
+	struct hash_elem text_elem;		// for text cache
+	struct inode *text_inode;		// cached read only elf page, NULL if not
+	off_t text_ofs;
+	size_t text_readb;				// bytes read, rest of the page is zero
+	bool sync;						// msync(MS_ASYNC) asked kswapd to write back
 };
 
-/* frame table for tracking USER frame(page) to evict page */
+#define FREE_FRAMES_LOW 8			// wake kswapd below this
+#define FREE_FRAMES_HIGH 32			// kswapd reclaims up to this
+#define PRECLEAN_SCAN 16			// frames ahead of hand kswapd cleans
+#define FAULT_AROUND_PAGES 8		// file pages mapped by one fault at most
+#define HUGE_FREE_MIN (2 * HPG_PAGES)	// free user pages needed to take a huge page
+
+/* frame table for tracking USER frame(page) to evict page
+ * frames는 clock algorithm의 ring으로 사용, hand는 다음에 확인할 frame */
 struct frame_table
 {
-	struct hash frames;
-	struct lock frame_lock;
+	struct list frames;
+	struct list_elem *hand;
+	size_t frame_cnt;				// frames in ring
+	struct lock frame_lock;			// for ring, free_frames and pinned
+	struct condition unpin_cond;	// signaled when frame is unpinned
+	struct list free_frames;		// reclaimed, not yet reused
+	size_t free_cnt;
 };
 
 /* The function table for page operations.
@@ -110,15 +138,36 @@ struct page_operations {
  * All designs up to you for this. */
 struct supplemental_page_table {
 	struct hash pages;
+	struct list vmas;				// regions sorted by start
+};
+
+/* elf segment나 mmap으로 만든 연속된 가상 주소 영역
+ * struct page는 영역 안의 주소를 처음 찾을 때 만듦(spt_find_page) */
+struct vma {
+	struct list_elem elem;			// in spt's vmas
+	void *start;
+	void *end;						// page aligned, exclusive
+	enum vm_type type;				// type of pages made from this region
+	bool writable;
+	struct inode *inode;			// reopened for mmap
+	off_t ofs;						// file offset of start
+	size_t read_bytes;				// bytes read from file, rest is zero
+	bool huge;						// MADV_HUGEPAGE, aligned chunks may be huge pages
+	int advice;						// MADV_* given by madvise
+	struct list pages;				// pages already made
 };
 
 /* vm */
-unsigned frame_hash(const struct hash_elem *p_, void *aux);
-bool frame_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux);
 bool page_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux);
 unsigned page_hash(const struct hash_elem *p_, void *aux );
 void hash_free_page(struct hash_elem *e, void *aux);
 bool ftb_delete_frame(struct page *delete_page);
+struct frame *vm_get_free_frame(void);
+void vm_frame_unpin(struct frame *frame);
+bool vm_frame_try_pin(struct frame *frame);
+void vm_wait_unpinned(struct page *page);
+void frame_rmap_add(struct frame *frame, struct page *page);
+size_t frame_rmap_remove(struct frame *frame, struct page *page);
 
 /* stack growth */
 bool vm_stack_growth(void *addr);
@@ -126,22 +175,9 @@ bool check_rsp_valid(void *addr);
 
 /* share and cp page */
 bool hash_copy_action(struct hash_elem *e, void *aux);
-// bool Is_alone(struct list_elem *elem, struct semaphore *sema);
-// void List_insert(struct list_elem *dst_elem, struct list_elem *src_elem, struct semaphore *sema);
-// void List_remove(struct list_elem *elem, struct semaphore *sema);
 
-/* sap out & in */
+/* sap out */
 void disable_redundant_frame(struct page *page);
-void enable_redundant_frame(struct page *page, struct frame *n_frame);
-
-/* check whether page is sharing or not */
-#define is_alone(elem) (((elem)->next) == (elem))
-
-/* initialize for copy elem which is used in hash_copy_action */
-#define circular_list_init(elem) do { \
-    (elem)->next = (elem); \
-    (elem)->prev = (elem); \
-} while (0)
 
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
@@ -152,6 +188,12 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+bool vma_insert (struct supplemental_page_table *spt, enum vm_type type, void *start,
+		size_t length, bool writable, struct inode *inode, off_t ofs, size_t read_bytes);
+bool vma_remove_mmap (struct supplemental_page_table *spt, void *start);
+void vma_take_mmap (struct supplemental_page_table *spt, struct list *mmaps);
+bool vma_msync (struct supplemental_page_table *spt, void *addr, size_t length, int flags);
+bool vma_madvise (struct supplemental_page_table *spt, void *addr, size_t length, int advice);
 
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
@@ -163,6 +205,7 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_unshare_page (struct page *page);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -0,0 +1,95 @@
+/* Arms, cancels and re-arms kernel timers and checks that they
+   fire in order of expiry.  Then arms timers beyond the span of
+   a timer wheel of its own, runs that wheel up to them and checks
+   that none fires early and they still fire in order. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "devices/timer.h"
+
+#define TIMER_CNT 10
+
+static struct timer_wheel wheel;
+static struct timer timers[TIMER_CNT];
+static int fired[TIMER_CNT];
+static int fired_cnt;
+
+static void
+record (void *aux)
+{
+  fired[fired_cnt++] = (intptr_t) aux;
+}
+
+static void
+check_fired (const int *expected, int cnt)
+{
+  int i;
+
+  if (fired_cnt != cnt)
+    fail ("%d timers fired, expected %d", fired_cnt, cnt);
+  for (i = 0; i < cnt; i++)
+    if (fired[i] != expected[i])
+      fail ("timer %d fired in place of timer %d", fired[i], expected[i]);
+  for (i = 0; i < cnt; i++)
+    msg ("timer %d fired", fired[i]);
+}
+
+void
+test_alarm_timer (void)
+{
+  static const int near_order[] = {3, 1, 4, 0, 2};
+  static const int far_order[] = {7, 9, 6};
+  enum intr_level old_level;
+  int64_t start;
+  int i;
+
+  for (i = 0; i < TIMER_CNT; i++)
+    timer_setup (&timers[i], record, (void *) (intptr_t) i);
+
+  /* Timer 3 is re-armed from the upper level to before the others,
+     timer 2 is cancelled and armed again, timer 5 is never armed. */
+  old_level = intr_disable ();
+  start = timer_ticks ();
+  timer_arm (&timers[0], start + 30);
+  timer_arm (&timers[1], start + 10);
+  timer_arm (&timers[2], start + 20);
+  timer_arm (&timers[3], start + 300);
+  timer_arm (&timers[4], start + 10);
+  if (!timer_cancel (&timers[2]))
+    fail ("cancelling a pending timer returned false");
+  timer_arm (&timers[3], start + 5);
+  timer_arm (&timers[2], start + 40);
+  if (timer_cancel (&timers[5]))
+    fail ("cancelling a timer never armed returned true");
+  intr_set_level (old_level);
+
+  timer_sleep (50);
+  check_fired (near_order, 5);
+  if (timer_cancel (&timers[1]))
+    fail ("cancelling a fired timer returned true");
+
+  /* On a wheel of our own, so the kernel's tick count is left
+     alone.  Timer 8 is cancelled, timer 9 is re-armed from inside
+     the span to beyond it. */
+  fired_cnt = 0;
+  start = 12345;
+  timer_wheel_init (&wheel, start);
+  timer_wheel_arm (&wheel, &timers[6], start + TIMER_WHEEL_SPAN + 1000);
+  timer_wheel_arm (&wheel, &timers[7], start + TIMER_WHEEL_SPAN + 300);
+  timer_wheel_arm (&wheel, &timers[8], start + TIMER_WHEEL_SPAN + 500);
+  timer_wheel_arm (&wheel, &timers[9], start + TIMER_WHEEL_SPAN - 1);
+  timer_cancel (&timers[8]);
+  timer_wheel_arm (&wheel, &timers[9], start + TIMER_WHEEL_SPAN + 700);
+
+  timer_wheel_run (&wheel, start + TIMER_WHEEL_SPAN + 299);
+  if (fired_cnt != 0)
+    fail ("timer %d fired before its expiry", fired[0]);
+  timer_wheel_run (&wheel, start + TIMER_WHEEL_SPAN + 300);
+  if (fired_cnt != 1)
+    fail ("timer 7 did not fire at its expiry");
+  timer_wheel_run (&wheel, start + TIMER_WHEEL_SPAN + 1000);
+  check_fired (far_order, 3);
+  pass ();
+}
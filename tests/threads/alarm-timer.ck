@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-timer) begin
+(alarm-timer) timer 3 fired
+(alarm-timer) timer 1 fired
+(alarm-timer) timer 4 fired
+(alarm-timer) timer 0 fired
+(alarm-timer) timer 2 fired
+(alarm-timer) timer 7 fired
+(alarm-timer) timer 9 fired
+(alarm-timer) timer 6 fired
+(alarm-timer) PASS
+(alarm-timer) end
+EOF
+pass;
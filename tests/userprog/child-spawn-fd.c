@@ -0,0 +1,34 @@
+/* Child process run by spawn-fd test.
+
+   Reads the file through the descriptor passed to spawn, given
+   as the first command-line argument, and checks that the
+   descriptor given as the second argument was not inherited. */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+
+int
+main (int argc, char *argv[]) 
+{
+  char byte;
+
+  test_name = "child-spawn-fd";
+
+  msg ("begin");
+  if (argc != 3 || !isdigit (*argv[1]) || !isdigit (*argv[2]))
+    fail ("bad command-line arguments");
+
+  int shared = atoi (argv[1]);
+  int private = atoi (argv[2]);
+  check_file_handle (shared, "sample.txt", sample, sizeof sample - 1);
+  CHECK (read (private, &byte, 1) == -1, "fd not passed to spawn is closed");
+
+  close (shared);
+  msg ("end");
+
+  return 0;
+}
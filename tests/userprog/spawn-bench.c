@@ -0,0 +1,37 @@
+/* Benchmark for process creation, not run by "make check".
+   Starts child-simple ITERATIONS times, waiting for each, either
+   with fork and exec or, given the argument "spawn", with spawn.
+   Compare the "Timer: N ticks" line printed at power off:
+     pintos -p tests/userprog/spawn-bench:spawn-bench
+       -p tests/userprog/child-simple:child-simple -- -q -f run 'spawn-bench fork'
+   and the same with 'spawn-bench spawn'. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define ITERATIONS 32
+
+int
+main (int argc, char *argv[])
+{
+  bool use_spawn = argc > 1 && !strcmp (argv[1], "spawn");
+  int i;
+
+  test_name = "spawn-bench";
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      pid_t pid;
+
+      if (use_spawn)
+        pid = spawn ("child-simple", NULL, 0);
+      else if ((pid = fork ("child-simple")) == 0)
+        exec ("child-simple");
+      if (pid < 0)
+        fail ("could not start child %d", i);
+      if (wait (pid) != 81)
+        fail ("child %d failed", i);
+    }
+  msg ("%d children %s", ITERATIONS, use_spawn ? "spawned" : "forked and exec'd");
+  return 0;
+}
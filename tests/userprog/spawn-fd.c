@@ -0,0 +1,29 @@
+/* Opens a file twice and spawns a child that inherits only the
+   first descriptor.  The child must be able to read the file
+   through the inherited descriptor, at the same number, and must
+   not have the other one.  Closing the inherited descriptor in the
+   child must not affect the parent's copy. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char child_cmd[128];
+  int shared, private;
+  pid_t pid;
+
+  CHECK ((shared = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((private = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+
+  snprintf (child_cmd, sizeof child_cmd, "child-spawn-fd %d %d", shared, private);
+  CHECK ((pid = spawn (child_cmd, &shared, 1)) > 0, "spawn(\"child-spawn-fd\")");
+  msg ("wait(spawn()) = %d", wait (pid));
+
+  check_file_handle (shared, "sample.txt", sample, sizeof sample - 1);
+  check_file_handle (private, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-fd) begin
+(spawn-fd) open "sample.txt"
+(spawn-fd) open "sample.txt" again
+(spawn-fd) spawn("child-spawn-fd")
+(child-spawn-fd) begin
+(child-spawn-fd) verified contents of "sample.txt"
+(child-spawn-fd) fd not passed to spawn is closed
+(child-spawn-fd) end
+child-spawn-fd: exit(0)
+(spawn-fd) wait(spawn()) = 0
+(spawn-fd) verified contents of "sample.txt"
+(spawn-fd) verified contents of "sample.txt"
+(spawn-fd) end
+spawn-fd: exit(0)
+EOF
+pass;
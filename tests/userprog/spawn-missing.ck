@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-missing) begin
+(spawn-missing) spawn("no-such-file"): -1
+(spawn-missing) end
+spawn-missing: exit(0)
+EOF
+pass;
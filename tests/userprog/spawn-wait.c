@@ -0,0 +1,15 @@
+/* Spawns a child process and waits for it, which must return
+   the child's exit status. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t pid;
+
+  CHECK ((pid = spawn ("child-simple", NULL, 0)) > 0, "spawn(\"child-simple\")");
+  msg ("wait(spawn()) = %d", wait (pid));
+}
@@ -0,0 +1,64 @@
+/* Forks and lets both processes write to the pages they share
+   after fork, checking that each side sees only its own writes.
+   The child makes no system call until it exits, so its writes run
+   alongside the parent's instead of after them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 8
+#define PAGE_SIZE 4096
+#define CHILD_PASSES 64
+#define CHILD_OK 42
+
+static char buf[PAGE_CNT][PAGE_SIZE];
+
+/* Returns true if every byte of page IDX is C. */
+static bool
+page_is (int idx, char c)
+{
+	for (int i = 0; i < PAGE_SIZE; i++)
+		if (buf[idx][i] != c)
+			return false;
+	return true;
+}
+
+/* Parent's view: even pages rewritten by the parent, odd pages
+   still hold what was there at fork. */
+static bool
+parent_pages_ok (void)
+{
+	for (int i = 0; i < PAGE_CNT; i++)
+		if (!page_is (i, i % 2 ? 'a' + i : 'A' + i))
+			return false;
+	return true;
+}
+
+void
+test_main (void)
+{
+	pid_t child;
+
+	for (int i = 0; i < PAGE_CNT; i++)
+		memset (buf[i], 'a' + i, PAGE_SIZE);
+
+	child = fork ("child");
+	if (child == 0) {
+		/* Writes every page, odd ones are still shared with the parent. */
+		for (int pass = 0; pass < CHILD_PASSES; pass++)
+			for (int i = 0; i < PAGE_CNT; i++) {
+				if (!page_is (i, pass ? '0' + i : 'a' + i))
+					exit (-1);
+				memset (buf[i], '0' + i, PAGE_SIZE);
+			}
+		exit (CHILD_OK);
+	}
+
+	for (int i = 0; i < PAGE_CNT; i += 2)
+		memset (buf[i], 'A' + i, PAGE_SIZE);
+	CHECK (parent_pages_ok (), "parent sees its own pages");
+	CHECK (wait (child) == CHILD_OK, "child saw only its own writes");
+	CHECK (parent_pages_ok (), "parent pages unchanged after child exit");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-parallel) begin
+(cow-parallel) parent sees its own pages
+(cow-parallel) child saw only its own writes
+(cow-parallel) parent pages unchanged after child exit
+(cow-parallel) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Writes to a file through a mapping and drops the page with
+   MADV_DONTNEED, which must write it back.  Then changes the file
+   with the write system call and checks that the next access
+   through the mapping loads the page again from the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  size_t size = strlen (sample);
+  int handle;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", size), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (ACTUAL, 4096, 1, handle, 0) == ACTUAL, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, size);
+  CHECK (madvise (ACTUAL, 4096, MADV_DONTNEED) == 0, "madvise MADV_DONTNEED");
+
+  read (handle, buf, size);
+  CHECK (!memcmp (buf, sample, size), "dropped page was written back");
+
+  memset (buf, 'x', size);
+  seek (handle, 0);
+  CHECK (write (handle, buf, size) == (int) size, "overwrite \"sample.txt\"");
+  CHECK (!memcmp (ACTUAL, buf, size), "mapping reloads the file");
+  munmap (ACTUAL);
+  close (handle);
+}
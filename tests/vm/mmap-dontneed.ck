@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-dontneed) begin
+(mmap-dontneed) create "sample.txt"
+(mmap-dontneed) open "sample.txt"
+(mmap-dontneed) mmap "sample.txt"
+(mmap-dontneed) madvise MADV_DONTNEED
+(mmap-dontneed) dropped page was written back
+(mmap-dontneed) overwrite "sample.txt"
+(mmap-dontneed) mapping reloads the file
+(mmap-dontneed) end
+EOF
+pass;
@@ -0,0 +1,71 @@
+/* Maps a file of one huge page and a small tail, asks for huge
+   pages with madvise, and checks that the aligned chunk is backed
+   by contiguous frames, reads the file, and writes back on
+   munmap like any other mapping. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (512 * PAGE_SIZE)
+#define FILE_SIZE (HUGE_SIZE + PAGE_SIZE)
+
+static char buf[PAGE_SIZE];
+
+static char
+page_byte (size_t page, bool written)
+{
+  return (written ? 'A' : 'a') + page % 26;
+}
+
+void
+test_main (void)
+{
+  size_t i, j;
+  int handle;
+  char *pa;
+
+  CHECK (create ("huge", 0), "create \"huge\"");
+  CHECK ((handle = open ("huge")) > 1, "open \"huge\"");
+  for (i = 0; i < FILE_SIZE / PAGE_SIZE; i++)
+    {
+      memset (buf, page_byte (i, false), PAGE_SIZE);
+      if (write (handle, buf, PAGE_SIZE) != PAGE_SIZE)
+        fail ("write page %zu of \"huge\"", i);
+    }
+
+  CHECK (mmap (ACTUAL, FILE_SIZE, 1, handle, 0) == ACTUAL, "mmap \"huge\"");
+  CHECK (madvise (ACTUAL, FILE_SIZE, MADV_HUGEPAGE) == 0, "madvise MADV_HUGEPAGE");
+
+  for (i = 0; i < FILE_SIZE / PAGE_SIZE; i++)
+    for (j = 0; j < PAGE_SIZE; j += 512)
+      if (ACTUAL[i * PAGE_SIZE + j] != page_byte (i, false))
+        fail ("byte %zu of page %zu differs from file", j, i);
+  msg ("mapping matches file");
+
+  pa = get_phys_addr (ACTUAL);
+  CHECK ((uintptr_t) pa % HUGE_SIZE == 0, "chunk starts on huge page boundary");
+  for (i = 1; i < HUGE_SIZE / PAGE_SIZE; i++)
+    if ((char *) get_phys_addr (ACTUAL + i * PAGE_SIZE) != pa + i * PAGE_SIZE)
+      fail ("page %zu of chunk is not contiguous", i);
+  msg ("chunk is physically contiguous");
+
+  for (i = 0; i < FILE_SIZE / PAGE_SIZE; i++)
+    ACTUAL[i * PAGE_SIZE] = page_byte (i, true);
+  munmap (ACTUAL);
+
+  seek (handle, 0);
+  for (i = 0; i < FILE_SIZE / PAGE_SIZE; i++)
+    {
+      if (read (handle, buf, PAGE_SIZE) != PAGE_SIZE)
+        fail ("read page %zu of \"huge\"", i);
+      if (buf[0] != page_byte (i, true) || buf[1] != page_byte (i, false))
+        fail ("page %zu was not written back", i);
+    }
+  msg ("file has the written bytes");
+  close (handle);
+}
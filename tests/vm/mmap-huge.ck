@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-huge) begin
+(mmap-huge) create "huge"
+(mmap-huge) open "huge"
+(mmap-huge) mmap "huge"
+(mmap-huge) madvise MADV_HUGEPAGE
+(mmap-huge) mapping matches file
+(mmap-huge) chunk starts on huge page boundary
+(mmap-huge) chunk is physically contiguous
+(mmap-huge) file has the written bytes
+(mmap-huge) end
+EOF
+pass;
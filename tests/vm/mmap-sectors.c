@@ -0,0 +1,51 @@
+/* Writes a few sectors of a mapped page, one of them twice
+   around an msync and another one back to its old contents, then
+   unmaps and checks that every sector of the file holds exactly
+   what the mapping last held. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGE_SIZE 4096
+#define SECTOR_SIZE 512
+#define SECTOR_CNT (PAGE_SIZE / SECTOR_SIZE)
+
+static char buf[PAGE_SIZE];
+static char expected[PAGE_SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  for (i = 0; i < SECTOR_CNT; i++)
+    memset (expected + i * SECTOR_SIZE, 'a' + i, SECTOR_SIZE);
+  CHECK (create ("sectors", 0), "create \"sectors\"");
+  CHECK ((handle = open ("sectors")) > 1, "open \"sectors\"");
+  CHECK (write (handle, expected, PAGE_SIZE) == PAGE_SIZE, "write \"sectors\"");
+  CHECK (mmap (ACTUAL, PAGE_SIZE, 1, handle, 0) == ACTUAL, "mmap \"sectors\"");
+
+  /* Sector 2 changes before and after msync, sector 5 in one byte,
+     sector 3 is changed and restored. */
+  memset (ACTUAL + 2 * SECTOR_SIZE, 'X', SECTOR_SIZE);
+  ACTUAL[5 * SECTOR_SIZE + 100] = 'Y';
+  ACTUAL[3 * SECTOR_SIZE] = 'W';
+  CHECK (msync (ACTUAL, PAGE_SIZE, MS_SYNC) == 0, "msync MS_SYNC");
+  ACTUAL[3 * SECTOR_SIZE] = 'a' + 3;
+  memset (ACTUAL + 2 * SECTOR_SIZE, 'Z', SECTOR_SIZE);
+  munmap (ACTUAL);
+
+  memset (expected + 2 * SECTOR_SIZE, 'Z', SECTOR_SIZE);
+  expected[5 * SECTOR_SIZE + 100] = 'Y';
+  seek (handle, 0);
+  CHECK (read (handle, buf, PAGE_SIZE) == PAGE_SIZE, "read \"sectors\"");
+  for (i = 0; i < SECTOR_CNT; i++)
+    if (memcmp (buf + i * SECTOR_SIZE, expected + i * SECTOR_SIZE, SECTOR_SIZE))
+      fail ("sector %zu of \"sectors\" is wrong", i);
+  msg ("every sector matches the mapping");
+  close (handle);
+}
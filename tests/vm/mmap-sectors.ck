@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-sectors) begin
+(mmap-sectors) create "sectors"
+(mmap-sectors) open "sectors"
+(mmap-sectors) write "sectors"
+(mmap-sectors) mmap "sectors"
+(mmap-sectors) msync MS_SYNC
+(mmap-sectors) read "sectors"
+(mmap-sectors) every sector matches the mapping
+(mmap-sectors) end
+EOF
+pass;
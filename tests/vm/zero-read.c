@@ -0,0 +1,33 @@
+/* Reads a BSS page before reading a file into it, so it is mapped
+   to the shared zero page when read() writes to it.  Then checks
+   that another untouched BSS page is still zero. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char untouched[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  size_t i;
+  int handle;
+
+  CHECK (buf[0] == 0, "read BSS page");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf, strlen (sample)) == (int) strlen (sample),
+         "read \"sample.txt\" into BSS page");
+  CHECK (!memcmp (buf, sample, strlen (sample)), "compare read data");
+  close (handle);
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (untouched[i] != 0)
+      fail ("byte %zu of untouched BSS page is %d", i, untouched[i]);
+  msg ("untouched BSS page is zero");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-read) begin
+(zero-read) read BSS page
+(zero-read) open "sample.txt"
+(zero-read) read "sample.txt" into BSS page
+(zero-read) compare read data
+(zero-read) untouched BSS page is zero
+(zero-read) end
+EOF
+pass;
@@ -37,6 +37,9 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef EFILESYS
+#include "filesys/page_cache.h"
+#endif
 
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
@@ -221,9 +224,15 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
+#ifdef VM
+		else if (!strcmp (name, "-swapra"))
+			swap_readaround = atoi (value);
+#endif
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
 #endif
@@ -326,8 +335,12 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -swapra=N          Read N pages per swap in (1 disables read-around).\n"
 #endif
 			);
 	power_off ();
@@ -356,6 +369,12 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+#endif
+#ifdef EFILESYS
+	page_cache_print_stats ();
+#endif
+#ifdef VM
+	anon_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
@@ -23,6 +23,9 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
+		/* Huge page: the directory entry is the last level. */
+		if (pdp[idx] & PTE_PS)
+			return create ? NULL : &pdp[idx];
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
@@ -169,7 +172,8 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		/* Frames of huge pages are freed by their owner. */
+		if ((((uint64_t) pte) & PTE_P) && !(pdp[i] & PTE_PS))
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -217,7 +221,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (PTE_ADDR (*pte)) +
+			((*pte & PTE_PS) ? hpg_ofs (uaddr) : pg_ofs (uaddr));
 	return NULL;
 }
 
@@ -243,6 +248,54 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Returns the address of the page directory entry for VA in
+ * PML4, creating upper level tables if CREATE is true. */
+static uint64_t *
+pde_walk (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *table = pml4;
+	int idx[2] = { PML4 (va), PDPE (va) };
+	for (int i = 0; i < 2; i++) {
+		if (!(table[idx[i]] & PTE_P)) {
+			if (!create)
+				return NULL;
+			uint64_t *new_page = palloc_get_page (PAL_ZERO);
+			if (new_page == NULL)
+				return NULL;
+			table[idx[i]] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (table[idx[i]]));
+	}
+	return &table[PDX (va)];
+}
+
+/* Maps HPGSIZE bytes at user virtual address UPAGE to the
+ * contiguous frames at KPAGE with one page directory entry.
+ * Both must be aligned to HPGSIZE.  A page table left there
+ * without any present entry is freed, otherwise UPAGE is
+ * considered occupied.  Returns true if successful. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT (hpg_ofs (upage) == 0);
+	ASSERT (hpg_ofs (vtop (kpage)) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pde_walk (pml4, (uint64_t) upage, 1);
+	if (pde == NULL)
+		return false;
+	if ((*pde & PTE_P) && !(*pde & PTE_PS)) {
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+		palloc_free_page (pt);
+	} else if (*pde & PTE_P)
+		return false;
+
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
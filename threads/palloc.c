@@ -284,6 +284,49 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
+/* Obtains HPG_PAGES contiguous free pages whose physical
+   address is aligned to HPGSIZE, so they can be mapped by one
+   page directory entry.  FLAGS are same as palloc_get_multiple.
+   Returns a null pointer if there is no such run. */
+void *
+palloc_get_huge (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_cnt = bitmap_size (pool->used_map);
+	size_t page_idx = hpg_ofs (HPGSIZE - hpg_ofs (vtop (pool->base))) / PGSIZE;
+	void *pages = NULL;
+
+	lock_acquire (&pool->lock);
+	for (; page_idx + HPG_PAGES <= page_cnt; page_idx += HPG_PAGES)
+		if (bitmap_none (pool->used_map, page_idx, HPG_PAGES)) {
+			bitmap_set_multiple (pool->used_map, page_idx, HPG_PAGES, true);
+			pages = pool->base + PGSIZE * page_idx;
+			break;
+		}
+	lock_release (&pool->lock);
+
+	if (pages) {
+		if (flags & PAL_ZERO)
+			memset (pages, 0, HPGSIZE);
+	} else {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get: out of pages");
+	}
+	return pages;
+}
+
+/* Returns the number of free pages in the user pool if
+   PAL_USER is set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t cnt;
+
+	lock_acquire (&pool->lock);
+	cnt = bitmap_count (pool->used_map, 0, bitmap_size (pool->used_map), false);
+	lock_release (&pool->lock);
+	return cnt;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
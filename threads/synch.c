@@ -110,6 +110,9 @@ void sema_up(struct semaphore *sema)
    ASSERT(sema != NULL);
 
    old_level = intr_disable();
+   if (thread_mlfqs)      // 대기하는 동안 밀린 decay를 적용해야 priority 비교가 맞음
+      for (struct list_elem *e = list_begin(&sema->waiters); e != list_end(&sema->waiters); e = list_next(e))
+         mlfq_refresh(list_entry(e, struct thread, elem));
    list_sort(&sema->waiters, priority_larger, WAIT_LIST);      // wait-on-sema 대신 삽입
    if (!list_empty(&sema->waiters))
       thread_unblock(list_entry(list_pop_front(&sema->waiters),
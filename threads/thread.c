@@ -27,9 +27,13 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  One FIFO queue per
+   priority, bit P of ready_bitmap is set if ready_queues[P] is
+   not empty. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static size_t ready_cnt;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -43,9 +47,6 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
-/* memory ticks for timer_sleep */
-static struct list sleep_list;
-
 /* Statistics. */
 static long long idle_ticks;   /* # of timer ticks spent idle. */
 static long long kernel_ticks; /* # of timer ticks in kernel threads. */
@@ -56,9 +57,10 @@ static long long user_ticks;   /* # of timer ticks in user programs. */
 static unsigned thread_ticks; /* # of timer ticks since last yield. */
 
 /* advanced scheduler */
-#define TIMER_FREQ 100
+#define DECAY_HISTORY 256		  /* # of recent_cpu decay 계수를 보관할 초 수 */
 static int load_avg = 0;
-static struct list thread_list;
+static int decay_epoch;					  /* 지금까지 적용된 1초 단위 decay 횟수 */
+static int decay_coef[DECAY_HISTORY];	  /* 각 decay 시점의 (2*load_avg)/(2*load_avg+1) */
 
 /* p.q float number */
 int f = (1 << 14);
@@ -75,6 +77,11 @@ static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
+static void ready_push(struct thread *t);
+static void ready_remove(struct thread *t);
+static int ready_max_priority(void);
+static void mlfq_decay(struct thread *t);
+static void thread_sleep_expired(void *t_);
 void fillock_release(void);
 
 /* Returns true if T appears to point to a valid thread. */
@@ -119,9 +126,11 @@ void thread_init(void)
 
 	/* Init the global thread context */
 	lock_init(&tid_lock);
-	list_init(&ready_list);
+	for (int i = PRI_MIN; i <= PRI_MAX; i++)
+		list_init(&ready_queues[i]);
+	ready_bitmap = 0;
+	ready_cnt = 0;
 	list_init(&destruction_req);
-	list_init(&sleep_list);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread();
@@ -130,10 +139,7 @@ void thread_init(void)
 	list_init(&initial_thread->donations);
 	initial_thread->tid = allocate_tid();
 	if (thread_mlfqs)
-	{
-		list_init(&thread_list);
 		mlfq_cal_priority(initial_thread);
-	}
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -178,33 +184,76 @@ void thread_tick(void)
 		intr_yield_on_return();
 }
 
-/* Time_freq마다 recent_cpu, load_avg 갱신, 4tick마다 priority갱신 후 우선 순위 선점*/
+/* tickless idle로 건너뛴 tick을 idle thread의 것으로 계산, interrupt를 끈 상태로 호출 */
+void thread_idle_tick(void)
+{
+	idle_ticks++;
+	if (thread_mlfqs)
+		mlfq_scheduler(idle_thread);
+}
+
+/* Time_freq마다 load_avg 갱신 후 running, ready thread만 decay, 4tick마다 running thread의 priority갱신
+   blocked thread는 깨어날 때 mlfq_refresh로 밀린 decay를 한번에 적용 */
 void mlfq_scheduler(struct thread *t)
 {
 	struct thread *tar_t;
-	struct list_elem *tar_elem;
+	struct list_elem *tar_elem, *next_elem;
+	uint64_t pending;
 	int now_tick = timer_ticks();
+	int pri;
 
 	if (t != idle_thread)
 		t->recent_cpu += N_to_FP(1);
 
-	// TIMER_FREQ(100) 마다 전체 thread를 순회하며 recent_cpu와 load_avg 갱신
-	if (now_tick % 4 == 0)
+	if (now_tick % TIMER_FREQ == 0)
 	{
-		if (now_tick % TIMER_FREQ == 0)
-			thread_cal_load_avg();
-		tar_elem = list_head(&thread_list);
-		while ((tar_elem = tar_elem->next) != &thread_list.tail)
+		thread_cal_load_avg();
+		decay_epoch++;
+		decay_coef[decay_epoch % DECAY_HISTORY] = DIV_X_Y(MUL_X_N(load_avg, 2), ADD_X_N(MUL_X_N(load_avg, 2), 1));
+
+		// 다음에 고를 후보인 ready thread는 바로 decay, priority가 바뀌면 queue 이동
+		pending = ready_bitmap;
+		while (pending)
 		{
-			tar_t = list_entry(tar_elem, struct thread, thread_elem);
-			if (now_tick % TIMER_FREQ == 0)
-				thread_cal_recent_cpu(tar_t);
-			mlfq_cal_priority(tar_t); // 4 tick마다 priority 갱신
-			if (tar_t->status == THREAD_BLOCKED)
-				thread_reschedule(tar_t);
+			pri = 63 - __builtin_clzll(pending);
+			pending &= ~(1ULL << pri);
+			for (tar_elem = list_begin(&ready_queues[pri]); tar_elem != list_end(&ready_queues[pri]); tar_elem = next_elem)
+			{
+				next_elem = list_next(tar_elem);
+				tar_t = list_entry(tar_elem, struct thread, elem);
+				mlfq_refresh(tar_t);
+				if (tar_t->priority != tar_t->ready_priority)
+					thread_readylist_reorder(tar_t);
+			}
 		}
-		list_sort(&ready_list, priority_larger, READY_LIST);
 	}
+
+	// recent_cpu가 바뀌는 건 running thread뿐이므로 이것만 priority 갱신
+	if (now_tick % 4 == 0 && t != idle_thread)
+		mlfq_refresh(t);
+}
+
+/* T가 놓친 1초 단위 decay를 순서대로 적용, DECAY_HISTORY보다 오래 밀렸으면 남은 계수 중 가장 오래된 것으로 근사 */
+static void
+mlfq_decay(struct thread *t)
+{
+	int oldest = decay_epoch - DECAY_HISTORY + 1;
+	int epoch;
+
+	while (t->cpu_epoch < decay_epoch)
+	{
+		epoch = ++t->cpu_epoch;
+		if (epoch < oldest)
+			epoch = oldest;
+		t->recent_cpu = ADD_X_N(MUL_X_Y(decay_coef[epoch % DECAY_HISTORY], t->recent_cpu), t->nice);
+	}
+}
+
+/* 밀린 decay를 적용하고 priority 재계산, interrupt를 끈 상태로 호출 */
+void mlfq_refresh(struct thread *t)
+{
+	mlfq_decay(t);
+	mlfq_cal_priority(t);
 }
 
 /* Prints thread statistics. */
@@ -277,6 +326,7 @@ tid_t thread_create(const char *name, int priority,
 	{
 		t->nice = thread_current()->nice;
 		t->recent_cpu = thread_current()->recent_cpu;
+		t->cpu_epoch = decay_epoch;
 		mlfq_cal_priority(t);
 	}
 	
@@ -318,12 +368,40 @@ void thread_unblock(struct thread *t)
 	old_level = intr_disable();
 	ASSERT(t->status == THREAD_BLOCKED);
 	t->status = THREAD_READY;
-	/* 우선순위 크기순으로 내림차순정렬 */
-	list_insert_ordered(&ready_list, &t->elem, priority_larger, READY_LIST);
+	if (thread_mlfqs)
+		mlfq_refresh(t);
+	ready_push(t);
 	intr_set_level(old_level);
 }
 
-/* 잠든 스레드를 sleep_list에 삽입하는 함수 */
+/* T를 priority의 ready queue 끝에 넣음, interrupt를 끈 상태로 호출 */
+static void
+ready_push(struct thread *t)
+{
+	t->ready_priority = t->priority;
+	list_push_back(&ready_queues[t->priority], &t->elem);
+	ready_bitmap |= 1ULL << t->priority;
+	ready_cnt++;
+}
+
+/* T를 들어가 있는 ready queue에서 제거, interrupt를 끈 상태로 호출 */
+static void
+ready_remove(struct thread *t)
+{
+	list_remove(&t->elem);
+	if (list_empty(&ready_queues[t->ready_priority]))
+		ready_bitmap &= ~(1ULL << t->ready_priority);
+	ready_cnt--;
+}
+
+/* ready thread 중 가장 높은 priority, 없으면 -1 */
+static int
+ready_max_priority(void)
+{
+	return ready_bitmap ? 63 - __builtin_clzll(ready_bitmap) : -1;
+}
+
+/* 현재 스레드를 TICKS 시각까지 재움, sleep_timer가 만료되면 깨어남 */
 void thread_sleep(int64_t ticks)
 {
 	struct thread *curr = thread_current();
@@ -332,44 +410,25 @@ void thread_sleep(int64_t ticks)
 	enum intr_level old_level;
 	old_level = intr_disable();
 
-	curr->wakeup_ticks = ticks;
-	list_insert_ordered(&sleep_list, &curr->elem, priority_larger, SLEEP_LIST);
+	timer_arm(&curr->sleep_timer, ticks);
 	thread_block();
 
 	intr_set_level(old_level);
 }
 
-/* 깨울 스레드를 sleep_list에서 제거하고 ready_list에 삽입 */
-void thread_wakeup(int64_t current_ticks)
+/* sleep_timer 만료 시 timer interrupt에서 호출, 잠든 스레드를 ready queue에 삽입 */
+static void
+thread_sleep_expired(void *t_)
 {
-	enum intr_level old_level;
-	old_level = intr_disable();
-
-	struct list_elem *curr_elem = list_begin(&sleep_list);
-	while (curr_elem != list_end(&sleep_list))
-	{
-		struct thread *curr_thread = list_entry(curr_elem, struct thread, elem);
-		if (current_ticks >= curr_thread->wakeup_ticks) // 깰 시간이 됐으면
-		{
-			curr_elem = list_remove(curr_elem);
-			thread_unblock(curr_thread);
-		}
-		else
-			break;
-	}
-	intr_set_level(old_level);
+	thread_unblock(t_);
 }
 
-/* ready_list에 현재 스레드의 priority보다 높은 priority를 가지는 스레드가 있으면 그 스레드에게 양보 */
+/* ready queue에 현재 스레드의 priority보다 높은 priority를 가지는 스레드가 있으면 그 스레드에게 양보 */
 void preempt_priority(void)
 {
 	if (thread_current() == idle_thread)
 		return;
-	if (list_empty(&ready_list))
-		return;
-	struct thread *curr = thread_current();
-	struct thread *ready = list_entry(list_front(&ready_list), struct thread, elem);
-	if (curr->priority < ready->priority) // ready_list에 현재 실행중인 스레드보다 우선순위가 높은 스레드가 있으면
+	if (thread_current()->priority < ready_max_priority()) // 현재 실행중인 스레드보다 우선순위가 높은 ready 스레드가 있으면
 		thread_yield();
 }
 
@@ -433,7 +492,7 @@ void thread_yield(void)
 
 	old_level = intr_disable();
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, priority_larger, READY_LIST); /* 우선순위 크기 순으로 내림차순정렬 */
+		ready_push(curr);
 	do_schedule(THREAD_READY);
 	intr_set_level(old_level);
 }
@@ -459,22 +518,18 @@ bool priority_larger(const struct list_elem *insert_elem, const struct list_elem
 		struct semaphore cmp = list_entry(cmp_elem, struct semaphore_elem, elem)->semaphore;
 		cmp_t = list_entry(list_begin(&cmp.waiters), struct thread, elem);
 		break;
-	case SLEEP_LIST:
-		t = list_entry(insert_elem, struct thread, elem);
-		cmp_t = list_entry(cmp_elem, struct thread, elem);
-		return t->wakeup_ticks < cmp_t->wakeup_ticks;
 	}
 	return t->priority > cmp_t->priority;
 }
-/* ready list에 있는 thread의 순서를 재정렬 */
+/* priority가 바뀐 ready thread를 새 priority의 ready queue 끝으로 옮김 */
 void thread_readylist_reorder(struct thread *t)
 {
 	ASSERT(t->status == THREAD_READY);
 
 	enum intr_level old_level;
 	old_level = intr_disable();
-	list_remove(&t->elem);
-	list_insert_ordered(&ready_list, &t->elem, priority_larger, READY_LIST);
+	ready_remove(t);
+	ready_push(t);
 	intr_set_level(old_level);
 }
 
@@ -524,17 +579,10 @@ int thread_get_recent_cpu(void)
 void thread_cal_load_avg(void)
 {
 	int ready_threads = (thread_current() != idle_thread) ? 1 : 0;
-	ready_threads += list_size(&ready_list);
+	ready_threads += ready_cnt;
 	load_avg = ADD_X_Y(MUL_X_Y(DIV_X_N(N_to_FP(59), 60), load_avg), MUL_X_N(DIV_X_N(N_to_FP(1), 60), ready_threads));
 }
 
-/* calculate recent_cpu */
-void thread_cal_recent_cpu(struct thread *t)
-{
-	int recent_cpu = ADD_X_N(MUL_X_Y(DIV_X_Y(MUL_X_N(load_avg, 2), ADD_X_N(MUL_X_N(load_avg, 2), 1)), t->recent_cpu), t->nice);
-	t->recent_cpu = recent_cpu;
-}
-
 /* mlfq(4.4BSD scheduler)방법으로 현재시각 기준 계산 */
 void mlfq_cal_priority(struct thread *t)
 {
@@ -577,7 +625,9 @@ idle(void *idle_started_ UNUSED)
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
 		   7.11.1 "HLT Instruction". */
+		timer_idle_enter();
 		asm volatile("sti; hlt" : : : "memory");
+		timer_idle_exit();
 	}
 }
 
@@ -615,9 +665,9 @@ init_thread(struct thread *t, const char *name, int priority)
 	list_init(&t->fdt_list);
 	list_init(&t->fet_list);
 
-	if (thread_mlfqs)
-		list_push_back(&thread_list, &t->thread_elem);
 	t->magic = THREAD_MAGIC;
+	/* alarm clock */
+	timer_setup(&t->sleep_timer, thread_sleep_expired, t);
 	
 	/* priority scheduling */
 	t->init_priority = priority;
@@ -627,6 +677,7 @@ init_thread(struct thread *t, const char *name, int priority)
 	/* advanced scheduler */ 
 	t->nice = 0;					
 	t->recent_cpu = 0;
+	t->cpu_epoch = decay_epoch;
 	/* filesys */
 	t->cwd = NULL;
 	t->cwd = 0;
@@ -640,10 +691,13 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
+	int priority = ready_max_priority();
+	if (priority < 0)
 		return idle_thread;
-	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+
+	struct thread *t = list_entry(list_front(&ready_queues[priority]), struct thread, elem);
+	ready_remove(t);
+	return t;
 }
 
 /* Use iretq to launch the thread */
@@ -809,8 +863,6 @@ schedule(void)
 		{
 			ASSERT(curr != next);
 			list_push_back(&destruction_req, &curr->elem);
-			if (thread_mlfqs)
-				list_remove(&curr->thread_elem);
 		}
 		/* Before switching the thread, we first save the information
 		 * of current running. */
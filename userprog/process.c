@@ -13,6 +13,7 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -26,6 +27,7 @@
 static void process_cleanup(void);
 static bool load(const char *file_name, struct intr_frame *if_);
 static void initd(void *f_name);
+static void __do_spawn(void *aux);
 static void __do_fork(void *);
 int wait(pid_t);
 void argument_passing(char *argv[], struct intr_frame *_if, int argc);
@@ -82,6 +84,48 @@ tid_t process_fork(const char *name)
 	return thread_create(name, PRI_DEFAULT, __do_fork, thread_current());
 }
 
+/* 부모의 주소 공간과 fdt를 복사하지 않고 ARGS의 명령을 실행할 process 생성
+ * 자식은 fork처럼 부모의 fork_list에 들어가므로 wait 가능
+ * Returns the new process's thread id, or TID_ERROR if the thread cannot be created. */
+tid_t process_spawn(struct spawn_args *args)
+{
+	char name[16], *next_ptr;
+	strlcpy(name, args->fn_copy, sizeof name);
+	strtok_r(name, " ", &next_ptr);
+	return thread_create(name, PRI_DEFAULT, __do_spawn, args);
+}
+
+/* spawn으로 만든 thread가 물려받은 fd를 같은 번호로 추가하고 실행파일을 load
+ * load에 실패하면 exec처럼 exit(-1) */
+static void
+__do_spawn(void *aux)
+{
+	struct spawn_args *args = aux;
+	struct thread *current = thread_current();
+	char *fn_copy = args->fn_copy;
+	bool succ = true;
+
+	dir_close(current->cwd);
+	current->cwd = args->cwd;
+
+	process_init();
+	for (int i = 0; i < args->fd_cnt; i++) {
+		if (succ && install_fd(current, args->fds[i], args->files[i]))
+			continue;
+		succ = false;
+		close_spawn_file(args->files[i]);
+	}
+	free(args);
+
+	if (!succ) {
+		palloc_free_page(fn_copy);
+		exit(-1);
+	}
+	if (process_exec(fn_copy) == -1)
+		exit(-1);
+	NOT_REACHED();
+}
+
 #ifndef VM
 /* Duplicate the parent's address space by passing this function to the
  * pml4_for_each. This is only for the project 2. */
@@ -190,14 +234,19 @@ int process_exec(void *f_name)
 
 	/* We first kill the current context */
 #ifdef VM
-	struct list inherit_list;
+	struct list inherit_list, inherit_vmas;
 	list_init(&inherit_list);
+	list_init(&inherit_vmas);
+	vma_take_mmap(&cur->spt, &inherit_vmas);
 	cur->spt.pages.aux = &inherit_list;		// mmap page preservation
 	process_cleanup();
 	supplemental_page_table_init(&cur->spt);
+	while (!list_empty(&inherit_vmas))
+		list_push_back(&cur->spt.vmas, list_pop_front(&inherit_vmas));
 	// mmap page inherit
 	while (!list_empty(&inherit_list)) {		
 		struct page *inpage = hash_entry((struct hash_elem *)list_pop_front(&inherit_list), struct page, hash_elem);
+		inpage->pml4 = cur->pml4;		// old pml4 is destroyed
 		if (!spt_insert_page(&cur->spt, inpage)
 				&& !pml4_set_page(cur->pml4, inpage->va, inpage->frame->kva, inpage->type & VM_WRITABLE))
 			return -1;
@@ -810,8 +859,10 @@ lazy_load_segment(struct page *page, void *aux)
 		return false;
 		
 	memset(kpage + page_read_bytes, 0, page_zero_bytes);	
-	// mmap load data is destoryed in file_backed_destroy
-	if (!(page->type & VM_MMAP))
+	if (page->type & VM_MMAP)
+		file_backed_hash_sectors(data, kpage);
+	// file load data is destoryed in file_backed_destroy
+	if (!(page->type & VM_FILE))
 		free(data);	
 	return true;
 }
@@ -838,9 +889,7 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(ofs % PGSIZE == 0);
 
-	int cnt = 0;
 	enum vm_type ty = VM_FILE; 
-	struct lazy_load_data *data;
 	if ((uint64_t)file & 1) {	// check mmap call
 		file = (uint64_t)file & ~1;
 		ty |= VM_MMAP; 
@@ -851,46 +900,9 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 		ty |= VM_ANON | VM_BSS;
 	}
 
-	while (read_bytes > 0 || zero_bytes > 0)
-	{
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-		if (!(data = (struct lazy_load_data *) malloc(sizeof(struct lazy_load_data))))
-			return false;
-
-		data->ofs = ofs;
-		data->pg_cnt = 0;
-		data->inode = file->inode;
-		data->readb = page_read_bytes;
-		if (!cnt++ && (ty & VM_MMAP)) 	// record mmap pg cnt
-			data->pg_cnt = read_bytes % PGSIZE ? read_bytes / PGSIZE + 1: read_bytes / PGSIZE;
-
-		if (ty & VM_MMAP)
-			inode_reopen(file->inode);
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		if (!vm_alloc_page_with_initializer(ty, upage,
-											writable, lazy_load_segment, data))
-		{	// delete page to reduce memory leak
-			while (cnt--) {
-				struct thread *cur = thread_current();
-				struct page *dpage = spt_find_page(&cur->spt, upage);
-				if (dpage)
-					spt_remove_page(&cur->spt, dpage);
-				upage -= PGSIZE;
-			}
-			return false;
-		}
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		ofs += PGSIZE;
-	}
-	return true;
+	/* pages are made on first access from the region (spt_find_page) */
+	return vma_insert(&thread_current()->spt, ty, upage, read_bytes + zero_bytes,
+					  writable, file->inode, ofs, read_bytes);
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -19,6 +19,7 @@
 #include "vm/vm.h"
 #include "filesys/directory.h"
 #include "filesys/fat.h"
+#include "filesys/page_cache.h"
 
 /* System call.
  *
@@ -69,15 +70,18 @@ int process_exec(void *f_name);
 void syscall_handler(struct intr_frame *);
 struct thread *find_child(pid_t pid, struct list *fork_list);
 int dup2(int oldfd, int newfd);
+pid_t spawn(const char *cmd_line, const int *fds, int fd_cnt);
 bool open_fety_fdt_in_page(struct func_params *params, struct thread *t);
 bool open_fdt_in_page(struct func_params *params, struct thread *t);
 bool delete_fety_fdt_in_page(struct func_params *params, struct thread *t);
 struct fpage *add_page_to_list(struct list_elem *elem, struct list *ls);
 bool find_file_in_page(struct func_params *params, struct list *ls);
 void update_offset(struct fpage *table, int i, call_type type);
-void write_to_read_page(void *uaddr);
+void write_to_read_page(void *uaddr, size_t size);
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int msync(void *addr, size_t length, int flags);
+int madvise(void *addr, size_t length, int advice);
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
@@ -176,6 +180,15 @@ void syscall_handler(struct intr_frame *f)
 		case SYS_DUP2:
 			f->R.rax = dup2(f->R.rdi, f->R.rsi);
 			break;
+		case SYS_SPAWN:
+			f->R.rax = spawn((const char *) f->R.rdi, (const int *) f->R.rsi, f->R.rdx);
+			break;
+		case SYS_MSYNC:
+			f->R.rax = msync((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_MADVISE:
+			f->R.rax = madvise((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
 		default:
 			printf("We don't implemented yet.");
 			break;
@@ -196,13 +209,18 @@ void check_address(void *uaddr)
 	}
 }
 
-/* 읽기전용 페이지에 쓰려고 하는경우 exit 호출 */
-void write_to_read_page(void *uaddr)
+/* 읽기전용 페이지에 쓰려고 하는경우 exit 호출
+ * kernel이 쓸 UADDR부터 SIZE byte의 page들은 zero page나 cow 공유를 미리 끊음 */
+void write_to_read_page(void *uaddr, size_t size)
 {	
 #ifdef VM	
-	struct page *find_page = spt_find_page(&thread_current()->spt, uaddr);
-	if (find_page && !(find_page->type & VM_WRITABLE))
-		exit(-1);
+	for (void *va = pg_round_down(uaddr); va < uaddr + size; va += PGSIZE) {
+		struct page *find_page = spt_find_page(&thread_current()->spt, va);
+		if (find_page && !(find_page->type & VM_WRITABLE))
+			exit(-1);
+		if (find_page && !vm_unshare_page(find_page))
+			exit(-1);
+	}
 #endif
 }
 
@@ -521,7 +539,7 @@ int read(int fd, void *buffer, unsigned size)
 		return -1;
 
 	check_address(buffer);
-	write_to_read_page(buffer);	
+	write_to_read_page(buffer, size);
 	int bytes_read = size;
 	if (cur_file == stdin_ptr)
 	{
@@ -646,6 +664,111 @@ int dup2(int oldfd, int newfd)
 	return newfd;
 }
 
+/* CMD_LINE의 첫 단어인 실행파일이 file로 존재하면 true, CMD_LINE은 그대로 돌려놓음 */
+static bool
+spawn_file_exists(char *cmd_line)
+{
+	while (*cmd_line == ' ')
+		cmd_line++;
+	char *end = strchr(cmd_line, ' ');
+	if (end)
+		*end = '\0';
+	struct file *file = filesys_open(cmd_line);
+	if (end)
+		*end = ' ';
+
+	if (file == NULL)
+		return false;
+	if (checkdir(file)) {
+		dir_close((struct dir *) getptr(file));
+		return false;
+	}
+	file_close(file);
+	return true;
+}
+
+/* 
+ * fork와 exec 없이 새 process를 만들어 cmd_line을 실행, fds의 fd_cnt개 fd만 같은 번호로 물려줌
+ * stdin, stdout, stderr는 항상 물려주고, 실행파일이 없으면 process를 만들지 않고 -1 return
+ * 실행파일을 load하지 못하면 exec처럼 자식이 exit(-1)
+ * 자식 pid return, fd가 잘못되었거나 process를 만들지 못하면 -1 return
+ */
+pid_t spawn(const char *cmd_line, const int *fds, int fd_cnt)
+{
+	check_address((void *) cmd_line);
+	if (fd_cnt < 0 || fd_cnt > SPAWN_FD_MAX)
+		return -1;
+	if (fd_cnt > 0) {
+		check_address((void *) fds);
+		check_address((uint8_t *)(fds + fd_cnt) - 1);
+	}
+
+	struct spawn_args *args = calloc(1, sizeof(struct spawn_args));
+	if (args == NULL)
+		return -1;
+	if ((args->fn_copy = palloc_get_page(0)) == NULL)
+		goto error;
+	strlcpy(args->fn_copy, cmd_line, PGSIZE);
+	if (!spawn_file_exists(args->fn_copy))
+		goto error;
+
+	// duplicate only requested files, skip stdin, stdout, stderr
+	struct func_params params;
+	for (int i = 0; i < fd_cnt; i++) {
+		if (fds[i] >= 0 && fds[i] <= 2)
+			continue;
+		for (int j = 0; j < args->fd_cnt; j++)
+			if (args->fds[j] == fds[i])
+				goto next;
+		params.fd = fds[i] + 1;
+		if (!find_file_in_page(&params, &thread_current()->fdt_list))
+			goto error;
+
+		struct file *new_file;
+		if (checkdir(params.file)) {
+			struct dir *dir = dir_reopen((struct dir *) getptr(params.file));
+			cwd_cnt_up(dir);
+			new_file = (struct file *) ((uint64_t)dir | 1);
+		} else if ((new_file = file_duplicate(params.file)) == NULL)
+			goto error;
+		args->fds[args->fd_cnt] = fds[i];
+		args->files[args->fd_cnt++] = new_file;
+next:	;
+	}
+
+	args->cwd = dir_reopen(thread_current()->cwd);
+	tid_t tid = process_spawn(args);
+	if (tid != TID_ERROR)
+		return tid;
+	dir_close(args->cwd);
+
+error:
+	for (int i = 0; i < args->fd_cnt; i++)
+		close_spawn_file(args->files[i]);
+	palloc_free_page(args->fn_copy);
+	free(args);
+	return -1;
+}
+
+/* spawn으로 물려받은 FILE을 T의 fdt에 FD 번호로 추가, 성공여부 return */
+bool install_fd(struct thread *t, int fd, struct file *file)
+{
+	struct func_params params;
+	params.file = file;
+	params.fd = fd + 1;
+	return open_fety_fdt_in_page(&params, t);
+}
+
+/* spawn에서 fdt에 추가하지 못한 FILE을 닫음 */
+void close_spawn_file(struct file *file)
+{
+	if (checkdir(file)) {
+		cwd_cnt_down((struct dir *) getptr(file));
+		dir_close((struct dir *) getptr(file));
+	} else
+		file_close(file);
+}
+
 /* fd로 열린 파일의 오프셋(offset) 바이트부터 length 바이트 만큼을 
 프로세스의 가상주소공간의 주소 addr 에 매핑 하여 주소를 반환, 실패시 -1반환
 lazy load, 메모리 중복 검사 및 다수의 예외 처리 포함 */
@@ -680,17 +803,24 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 /* 지정된 주소 범위 addr에 대한 매핑을 해제, mmap에 의해 연결된 page들을 unmap*/
 void munmap(void *addr)
 {	
-	struct thread *cur = thread_current();
-	struct page *mpage = spt_find_page(&cur->spt, addr);
-	if (!mpage || !(mpage->type & VM_MMAP))
-		return;
-
-	int pg_cnt = mpage->file.data->pg_cnt;
-	while(pg_cnt--) {
-		spt_remove_page(&cur->spt, mpage);
-		addr += PGSIZE;
-		mpage = spt_find_page(&cur->spt, addr);
-	}
+	vma_remove_mmap(&thread_current()->spt, addr);
+}
+
+/* addr부터 length byte의 mmap page 중 dirty인 page를 file에 기록, 실패시 -1
+ * MS_SYNC면 기록이 끝난 뒤 return, MS_ASYNC면 kswapd가 기록 */
+int msync(void *addr, size_t length, int flags)
+{
+	if (!vma_msync(&thread_current()->spt, addr, length, flags))
+		return -1;
+	return 0;
+}
+
+/* addr부터 length byte를 어떻게 사용할지 알려서 read-around와 evict에 반영, 실패시 -1 */
+int madvise(void *addr, size_t length, int advice)
+{
+	if (!vma_madvise(&thread_current()->spt, addr, length, advice))
+		return -1;
+	return 0;
 }
 
 /* directory path가 유효한지 검증하며 cwd를 변경 */
@@ -823,12 +953,12 @@ int symlink (const char* target, const char* linkpath) {
 
 	// init symlink 
 	disk_inode->isdir = 2;	// link flg
-	disk_write(filesys_disk, file_entity->inode->sector, disk_inode);
+	page_cache_write (file_entity->inode->sector, disk_inode);
 	
 	// record file name
 	char buf[512];
 	strlcpy(buf, target, sizeof(target) + 1);
-	disk_write(filesys_disk, disk_inode->start, buf);
+	page_cache_write (disk_inode->start, buf);
 	file_close(file_entity);
 	return 0;
 }
\ No newline at end of file
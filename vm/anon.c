@@ -1,6 +1,7 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <stdio.h>
 #include "devices/disk.h"
 #include "threads/vaddr.h"
 #include "lib/string.h"
@@ -24,7 +25,8 @@ static const struct page_operations anon_ops = {
 
 struct swap_table {
 	struct lock s_lock;               
-	struct bitmap *used_map
+	struct bitmap *used_map;
+	uint16_t *slot_refs;              // pages sharing each slot
 };
 
 /* An ATA device. */
@@ -41,11 +43,22 @@ struct disk {
 };
 
 static void delete_swap_anon_page(struct page *page);
+static size_t alloc_swap_slots(size_t cnt);
+static void release_anon_frame(struct page *page, disk_sector_t disk_sector, bool noswap);
+static void swap_slot_put(disk_sector_t disk_sector);
+static size_t get_readaround_pages(struct page *page, struct page **around);
 
 // similar to palloc pool which is differ from using next-fit
 static struct swap_table stb;
 static size_t next_fit_idx;
 struct lock anon_cp_lock;
+static struct disk_request swap_reqs[SWAP_BATCH];		// protected by s_lock
+
+int swap_readaround = SWAP_READAROUND;
+static struct lock ra_lock;
+static struct disk_request ra_reqs[SWAP_READAROUND_MAX];	// protected by ra_lock
+static long long prefetch_cnt;		// pages mapped by read-around
+static long long prefetch_hit_cnt;	// of them, accessed before eviction
 
 
 /* Initialize the data for anonymous pages */
@@ -55,6 +68,11 @@ vm_anon_init (void) {
 	swap_disk = (struct disk *)malloc(sizeof swap_disk);
 	swap_disk = disk_get(1, 1);
 	lock_init(&stb.s_lock);
+	lock_init(&ra_lock);
+	if (swap_readaround < 1)
+		swap_readaround = 1;
+	if (swap_readaround > SWAP_READAROUND_MAX)
+		swap_readaround = SWAP_READAROUND_MAX;
 
 	// cal pages cnts
 	size_t dsk_pages = DIV_ROUND_UP(bitmap_buf_size(swap_disk->capacity/8), PGSIZE);
@@ -62,6 +80,8 @@ vm_anon_init (void) {
 	stb.used_map = palloc_get_multiple(0, dsk_pages);
 	// set all used_map to be 0
 	stb.used_map = bitmap_create_in_buf(swap_disk->capacity/8, stb.used_map, dsk_pages * PGSIZE);	 
+	size_t ref_pages = DIV_ROUND_UP(swap_disk->capacity/8 * sizeof(uint16_t), PGSIZE);
+	stb.slot_refs = palloc_get_multiple(PAL_ASSERT | PAL_ZERO, ref_pages);
 	next_fit_idx = 0;	// next fit idx
 }
 
@@ -86,91 +106,273 @@ anon_swap_in (struct page *page, void *kva) {
 		return true;
 	}
 
-	size_t readb = 0;
-	size_t size = PGSIZE;
-	disk_sector_t disk_sector = page->anon.disk_sector;
-	while (size) {	// size_left must be divided 512
-		int size_left = (size > DISK_SECTOR_SIZE) ? DISK_SECTOR_SIZE : size;
-		disk_read(swap_disk, disk_sector++, page->frame->kva + readb);
-		size -= DISK_SECTOR_SIZE;
-		readb += size_left;
+	// read page with swapped neighbors, queued together to be merged
+	struct page *around[SWAP_READAROUND_MAX];
+	lock_acquire(&ra_lock);
+	around[0] = page;
+	size_t cnt = get_readaround_pages(page, around);
+	for (size_t i = 0; i < cnt; i++) {
+		disk_request_init(&ra_reqs[i], swap_disk, around[i]->anon.disk_sector,
+				PGSIZE / DISK_SECTOR_SIZE, around[i]->frame->kva, false);
+		disk_submit(&ra_reqs[i], NULL, NULL);
 	}
-	// mark bitmap false
-	ASSERT(bitmap_all(stb.used_map, page->anon.disk_sector/8, 1));
-	bitmap_set_multiple(stb.used_map, page->anon.disk_sector/8, 1, false);
+	for (size_t i = 0; i < cnt; i++)
+		disk_wait(&ra_reqs[i]);
+	lock_release(&ra_lock);
 
-	// enable pml4 for pages which is sharing redundant frames
-	struct list_elem *next_e = &page->cp_elem; 
-	while((next_e = list_next(next_e)) != &page->cp_elem) {
-		struct page *f_page = list_entry(next_e, struct page, cp_elem);
-		enable_redundant_frame(f_page, page->frame);	// enable pml4
-	}
+	for (size_t i = 0; i < cnt; i++)
+		swap_slot_put(around[i]->anon.disk_sector);
 
+	// map prefetched pages, swap slot is released so they must be written back
+	for (size_t i = 1; i < cnt; i++) {
+		struct page *n_page = around[i];
+		n_page->type |= VM_DIRTY | VM_PREFETCH;
+		pml4_set_page(n_page->pml4, n_page->va, n_page->frame->kva, n_page->type & VM_WRITABLE);
+		vm_frame_unpin(n_page->frame);
+		prefetch_cnt++;
+	}
 	return true;
 }
 
+/* PAGE 뒤쪽의 가상 page들 중 바로 다음 swap slot에 있는 page를 swap_readaround개까지
+ * 모아서 AROUND[1..]에 담고 free frame을 연결, AROUND[0]인 PAGE를 포함한 개수 return
+ * slot을 공유하거나 이어지지 않는 page에서 멈추고, frame이 없으면 evict하지 않고 멈춤
+ * 참조가 하나인 slot은 해당 page만 바꾸므로 s_lock 없이 확인 */
+static size_t
+get_readaround_pages(struct page *page, struct page **around) {
+	struct thread *cur = thread_current();
+	size_t cnt = 1;
+
+	if (page->pml4 != cur->pml4)
+		return cnt;
+
+	while (cnt < (size_t) swap_readaround) {
+		struct page *n_page = spt_find_page(&cur->spt, page->va + cnt * PGSIZE);
+		if (!n_page || n_page->operations->type != VM_ANON
+				|| (n_page->type & (VM_FRAME | VM_NOSWAP))
+				|| n_page->anon.disk_sector != page->anon.disk_sector + cnt * 8
+				|| stb.slot_refs[n_page->anon.disk_sector/8] != 1)
+			break;
+
+		struct frame *frame = vm_get_free_frame();
+		if (!frame)
+			break;
+		frame_rmap_add(frame, n_page);
+		around[cnt++] = n_page;
+	}
+	return cnt;
+}
+
+/* read-around로 올라온 page가 사용되었는지 확인, accessed bit을 지우기 전에 호출 */
+void
+anon_prefetch_account(struct page *page) {
+	if (!(page->type & VM_PREFETCH))
+		return;
+	if (pml4_is_accessed(page->pml4, page->va)) {
+		page->type &= ~VM_PREFETCH;
+		prefetch_hit_cnt++;
+	}
+}
+
+/* Prints swap read-around statistics. */
+void
+anon_print_stats(void) {
+	printf("Swap read-around: %lld prefetched, %lld used\n", prefetch_cnt, prefetch_hit_cnt);
+}
+
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	ASSERT(page->frame && (page->type & VM_FRAME));
-	// not bss and not dirty (no need since malloc isn't impl)
-	if (!(page->type & VM_BSS) && !((page->type & VM_DIRTY) || pml4_is_dirty(page->pml4, page->va))) {
-		page->type |= VM_NOSWAP;
-		// add disable_redundant_frame
-		return true;	
+	return anon_swap_out_batch(&page, 1);
+}
+
+/* PAGES의 CNT개 anon page를 swap out, 기록이 필요한 page들은 연속된 slot에
+ * 배치하고 한번에 disk queue에 넣어서 하나의 큰 요청으로 합쳐지도록 함 */
+bool
+anon_swap_out_batch (struct page **pages, size_t cnt) {
+	struct page *dirty[SWAP_BATCH];
+	size_t dirty_cnt = 0;
+
+	ASSERT(cnt <= SWAP_BATCH);
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *page = pages[i];
+		ASSERT(page->frame && (page->type & VM_FRAME));
+		anon_prefetch_account(page);
+		page->type &= ~VM_PREFETCH;
+		// written by anon_preclean and not modified since, only drop the frame
+		if ((page->type & VM_SWAPCACHE)
+				&& !((page->type & VM_DIRTY) || pml4_is_dirty(page->pml4, page->va))) {
+			page->type &= ~VM_SWAPCACHE;
+			lock_acquire(&stb.s_lock);
+			release_anon_frame(page, page->anon.disk_sector, false);
+			lock_release(&stb.s_lock);
+			continue;
+		}
+		anon_drop_swap_cache(page);
+		// not bss and not dirty (no need since malloc isn't impl)
+		if (!(page->type & VM_BSS) && !((page->type & VM_DIRTY) || pml4_is_dirty(page->pml4, page->va))) {
+			release_anon_frame(page, 0, true);
+		} else
+			dirty[dirty_cnt++] = page;
 	}
+	if (!dirty_cnt)
+		return true;
 
-	// similar to palloc_get_multiple but find policy is next-fit
-	size_t start = next_fit_idx;
 	lock_acquire(&stb.s_lock);
-	size_t bit_idx = bitmap_scan_and_flip(stb.used_map, next_fit_idx, 1, false);
-	if (bit_idx == BITMAP_ERROR) {
-		bit_idx = bitmap_scan_and_flip(stb.used_map, 0, 1, false);
-		if (bit_idx == BITMAP_ERROR)
+	size_t bit_idx = alloc_swap_slots(dirty_cnt);
+	if (bit_idx == BITMAP_ERROR) {	// no contiguous slots, one by one
+		if (dirty_cnt == 1)
 			PANIC("no place in swap disk");
+		lock_release(&stb.s_lock);
+		for (size_t i = 0; i < dirty_cnt; i++)
+			anon_swap_out_batch(&dirty[i], 1);
+		return true;
+	}
+
+	// unmap first so that nobody writes the page while it is written out
+	for (size_t i = 0; i < dirty_cnt; i++) {
+		struct frame *frame = dirty[i]->frame;
+		lock_acquire(&frame->rmap_lock);
+		for (struct list_elem *e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e)) {
+			struct page *f_page = list_entry(e, struct page, rmap_elem);
+			pml4_clear_page(f_page->pml4, f_page->va);
+		}
+		lock_release(&frame->rmap_lock);
 	}
+
+	// write every page before waiting, disk merges adjacent slots
+	for (size_t i = 0; i < dirty_cnt; i++) {
+		disk_request_init(&swap_reqs[i], swap_disk, (bit_idx + i) * 8,
+				PGSIZE / DISK_SECTOR_SIZE, dirty[i]->frame->kva, true);
+		disk_submit(&swap_reqs[i], NULL, NULL);
+	}
+	for (size_t i = 0; i < dirty_cnt; i++)
+		disk_wait(&swap_reqs[i]);
+
+	// slot refs are counted before any sharer can swap in
+	for (size_t i = 0; i < dirty_cnt; i++)
+		release_anon_frame(dirty[i], (bit_idx + i) * 8, false);
 	lock_release(&stb.s_lock);
-	next_fit_idx = (bitmap_size(stb.used_map) < bit_idx + 1) ? 0 : bit_idx + 1;
-	
+	return true;
+}
 
-	// similar to inode_write_at except for fixed size(PGSIZE)
-	size_t writeb = 0;
-	size_t size = PGSIZE;
-	disk_sector_t disk_sector = bit_idx * 8;
-	while (size) {	// size_left must be divided 512
-		size_t size_left = (size > DISK_SECTOR_SIZE) ? DISK_SECTOR_SIZE : size;
-		disk_write(swap_disk, disk_sector++, page->frame->kva + writeb);
-		size -= DISK_SECTOR_SIZE;
-		writeb += size_left;
+/* swap disk에서 연속된 CNT개 slot을 next-fit으로 찾아 첫 slot return
+ * 없으면 BITMAP_ERROR return, s_lock을 잡은 상태로 호출 */
+static size_t
+alloc_swap_slots(size_t cnt) {
+	size_t bit_idx = bitmap_scan_and_flip(stb.used_map, next_fit_idx, cnt, false);
+	if (bit_idx == BITMAP_ERROR) {
+		bit_idx = bitmap_scan_and_flip(stb.used_map, 0, cnt, false);
+		if (bit_idx == BITMAP_ERROR)
+			return BITMAP_ERROR;
 	}
+	next_fit_idx = (bitmap_size(stb.used_map) < bit_idx + cnt + 1) ? 0 : bit_idx + cnt;
+	return bit_idx;
+}
+
+/* 최근에 접근하지 않은 dirty anon page CNT개를 frame에 둔 채 연속된 slot에 미리 기록
+ * dirty bit을 먼저 지워서 기록 중에 수정되면 evict할 때 다시 기록하고, 아니면 frame만 놓음
+ * PAGES의 frame은 pinned이고 다른 page와 공유하지 않는 상태, slot이 없으면 아무것도 안함 */
+void
+anon_preclean (struct page **pages, size_t cnt) {
+	ASSERT(cnt <= SWAP_BATCH);
+	if (cnt == 0)
+		return;
+
+	lock_acquire(&stb.s_lock);
+	size_t bit_idx = alloc_swap_slots(cnt);
+	if (bit_idx == BITMAP_ERROR) {
+		lock_release(&stb.s_lock);
+		return;
+	}
+	for (size_t i = 0; i < cnt; i++) {
+		pages[i]->type &= ~VM_DIRTY;
+		pml4_set_dirty(pages[i]->pml4, pages[i]->va, false);
+		disk_request_init(&swap_reqs[i], swap_disk, (bit_idx + i) * 8,
+				PGSIZE / DISK_SECTOR_SIZE, pages[i]->frame->kva, true);
+		disk_submit(&swap_reqs[i], NULL, NULL);
+	}
+	for (size_t i = 0; i < cnt; i++) {
+		disk_wait(&swap_reqs[i]);
+		// slot has no reference until the frame is dropped
+		pages[i]->anon.disk_sector = (bit_idx + i) * 8;
+		pages[i]->type |= VM_SWAPCACHE;
+	}
+	lock_release(&stb.s_lock);
+}
+
+/* anon_preclean으로 기록해둔 PAGE의 slot을 비움, 기록한 뒤 수정되었거나 frame을 공유하게 될 때 호출 */
+void
+anon_drop_swap_cache (struct page *page) {
+	if (!(page->type & VM_SWAPCACHE))
+		return;
+	page->type &= ~VM_SWAPCACHE;
+	lock_acquire(&stb.s_lock);
+	ASSERT(stb.slot_refs[page->anon.disk_sector/8] == 0);
+	bitmap_set_multiple(stb.used_map, page->anon.disk_sector/8, 1, false);
+	lock_release(&stb.s_lock);
+}
+
+/* swap out된 page와 frame을 공유하는 page들의 swap 위치를 기록하고 reverse map과 pml4에서 제거
+ * NOSWAP이면 기록하지 않은 page로 표시해서 swap in할 때 0으로 채움
+ * 아니면 s_lock을 잡은 상태로 호출, slot 참조 수는 sharer 수 */
+static void
+release_anon_frame(struct page *page, disk_sector_t disk_sector, bool noswap) {
+	struct frame *frame = page->frame;
+	struct page *f_page;
 
 	// cp disksector pos for pages which is sharing redundant frames
-	struct list_elem *next_e = &page->cp_elem; 
-	do {
-		struct page *f_page = list_entry(next_e, struct page, cp_elem);
-		f_page->anon.disk_sector = bit_idx * 8;
+	while ((f_page = frame->page) != NULL) {
+		f_page->anon.disk_sector = disk_sector;
+		if (noswap)
+			f_page->type |= VM_NOSWAP;
+		else
+			stb.slot_refs[disk_sector/8]++;
 		disable_redundant_frame(f_page);	// disable pml4
-	} while((next_e = list_next(next_e)) != &page->cp_elem);
+	}
+}
 
-	return true;
+/* swap slot의 참조 하나를 놓고, 마지막 참조면 slot을 비움 */
+static void
+swap_slot_put(disk_sector_t disk_sector) {
+	size_t slot = disk_sector / 8;
+
+	lock_acquire(&stb.s_lock);
+	ASSERT(bitmap_all(stb.used_map, slot, 1) && stb.slot_refs[slot] > 0);
+	if (--stb.slot_refs[slot] == 0)
+		bitmap_set_multiple(stb.used_map, slot, 1, false);
+	lock_release(&stb.s_lock);
+}
+
+/* fork로 복사된 PAGE가 swap out된 상태면 slot을 함께 참조 */
+void
+anon_share_swap_slot(struct page *page) {
+	if (page->operations->type != VM_ANON || (page->type & (VM_FRAME | VM_NOSWAP)))
+		return;
+	lock_acquire(&stb.s_lock);
+	stb.slot_refs[page->anon.disk_sector/8]++;
+	lock_release(&stb.s_lock);
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
+	// zero frame must not be freed by pml4_destroy
+	if (page->type & VM_ZERO)
+		pml4_clear_page(page->pml4, page->va);
+
 	// marking stb bitmap sector usable 
+	if (page->type & VM_FRAME)
+		anon_prefetch_account(page);
+	anon_drop_swap_cache(page);
 	delete_swap_anon_page(page);
 	ftb_delete_frame(page);
 	return;
 }
 
-/* cpwrite에 의해 page을 중복 참조하지 않는 경우 경우만 삭제 */
+/* swap out된 page면 slot 참조를 놓음, 다른 page가 참조 중이면 slot은 남음 */
 static void delete_swap_anon_page(struct page *page)
 {	
-	if (!(page->type & VM_FRAME) && is_alone(&page->cp_elem)) {
-		size_t disk_sector = page->anon.disk_sector;
-
-		ASSERT(bitmap_all(stb.used_map, disk_sector/8, 1));
-		bitmap_set_multiple(stb.used_map, disk_sector/8, 1, false);	
-	}
+	if (!(page->type & (VM_FRAME | VM_NOSWAP)))
+		swap_slot_put(page->anon.disk_sector);
 }
\ No newline at end of file
@@ -1,12 +1,27 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <string.h>
 #include "vm/vm.h"
 #include "userprog/process.h"
+#include "threads/malloc.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
 static void delete_mmap_page(struct page *page);
+static bool file_page_is_dirty(struct page *page);
+static void write_dirty_sectors(struct page *page, void *kva);
+static void write_sectors(struct lazy_load_data *data, void *kva, size_t ofs, size_t len);
+static uint64_t text_hash(const struct hash_elem *e, void *aux);
+static bool text_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux);
+static bool is_text_page(struct page *page, struct lazy_load_data *data);
+static struct inode *text_uncache(struct frame *frame);
+
+/* 여러 process가 실행하는 같은 elf의 읽기 전용 page를 (inode, ofs, readb)로 찾는 cache
+ * 같은 file page라도 segment마다 readb 뒤를 0으로 채우는 범위가 다를 수 있음
+ * frame이 올라와 있는 동안만 등록, 각 frame은 inode를 열어둠 */
+static struct hash text_cache;
+static struct lock text_lock;
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -19,6 +34,116 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	hash_init(&text_cache, text_hash, text_less, NULL);
+	lock_init(&text_lock);
+}
+
+/* text cache hashing 하는 함수 */
+static uint64_t
+text_hash(const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *f = hash_entry(e, struct frame, text_elem);
+	return hash_bytes(&f->text_inode, sizeof f->text_inode) ^ hash_int(f->text_ofs)
+			^ hash_int(f->text_readb);
+}
+
+/* Returns true if text frame a precedes text frame b. */
+static bool
+text_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct frame *a = hash_entry(a_, struct frame, text_elem);
+	const struct frame *b = hash_entry(b_, struct frame, text_elem);
+	if (a->text_inode != b->text_inode)
+		return a->text_inode < b->text_inode;
+	if (a->text_ofs != b->text_ofs)
+		return a->text_ofs < b->text_ofs;
+	return a->text_readb < b->text_readb;
+}
+
+/* mmap이 아닌 읽기 전용 elf page인지 확인 */
+static bool
+is_text_page(struct page *page, struct lazy_load_data *data) {
+	return VM_TYPE(page->type) == VM_FILE && !(page->type & (VM_MMAP | VM_WRITABLE))
+			&& data && data->inode;
+}
+
+/* 같은 elf page가 이미 다른 process의 frame에 있으면 reverse map에 추가하고 읽기 전용으로 mapping
+ * evict 중인 frame은 기다리지 않고 false, 직접 읽도록 함 */
+bool
+file_backed_share_text(struct page *page) {
+	bool uninit = page->operations->type == VM_UNINIT;
+	struct lazy_load_data *data = uninit ? page->uninit.aux : page->file.data;
+	struct frame key, *frame = NULL;
+
+	if (uninit && page->uninit.init != lazy_load_segment)
+		return false;
+	if (!is_text_page(page, data))
+		return false;
+
+	key.text_inode = data->inode;
+	key.text_ofs = data->ofs;
+	key.text_readb = data->readb;
+	lock_acquire(&text_lock);
+	struct hash_elem *e = hash_find(&text_cache, &key.text_elem);
+	if (e && vm_frame_try_pin(hash_entry(e, struct frame, text_elem))) {
+		frame = hash_entry(e, struct frame, text_elem);
+		if (uninit)		// file page without loading
+			page->uninit.page_initializer(page, page->type, frame->kva);
+		frame_rmap_add(frame, page);
+	}
+	lock_release(&text_lock);
+	if (frame == NULL)
+		return false;
+
+	bool succ = pml4_set_page(thread_current()->pml4, page->va, frame->kva, false);
+	vm_frame_unpin(frame);
+	return succ;
+}
+
+/* 방금 읽어온 elf page의 frame을 text cache에 등록, 이미 있으면 그대로 둠
+ * frame은 pinned이고 PAGE만 참조하는 상태로 호출 */
+void
+file_backed_cache_text(struct page *page) {
+	struct frame *frame = page->frame;
+	if (!is_text_page(page, page->file.data) || frame->text_inode)
+		return;
+
+	struct lazy_load_data *data = page->file.data;
+	frame->text_inode = data->inode;
+	frame->text_ofs = data->ofs;
+	frame->text_readb = data->readb;
+	lock_acquire(&text_lock);
+	if (hash_insert(&text_cache, &frame->text_elem) != NULL)
+		frame->text_inode = NULL;
+	else
+		inode_reopen(data->inode);
+	lock_release(&text_lock);
+}
+
+/* FRAME을 text cache에서 제거하고 닫아야 할 inode return, text_lock을 잡은 상태로 호출 */
+static struct inode *
+text_uncache(struct frame *frame) {
+	struct inode *inode = frame->text_inode;
+	if (inode) {
+		hash_delete(&text_cache, &frame->text_elem);
+		frame->text_inode = NULL;
+	}
+	return inode;
+}
+
+/* PAGE를 FRAME의 reverse map에서 제거하고 남은 참조 수 return
+ * 마지막 참조면 text cache에서도 제거, 찾는 쪽과 겹치지 않도록 text_lock 안에서 제거 */
+size_t
+file_backed_release_frame(struct frame *frame, struct page *page) {
+	if (frame->text_inode == NULL)
+		return frame_rmap_remove(frame, page);
+
+	struct inode *inode = NULL;
+	lock_acquire(&text_lock);
+	size_t ref_cnt = frame_rmap_remove(frame, page);
+	if (ref_cnt == 0)
+		inode = text_uncache(frame);
+	lock_release(&text_lock);
+	inode_close(inode);
+	return ref_cnt;
 }
 
 /* Initialize the file backed page */
@@ -35,39 +160,129 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	// enable pml4 for pages which is sharing redundant frames
-	struct list_elem *next_e = &page->cp_elem; 
-	while((next_e = list_next(next_e)) != &page->cp_elem) {
-		struct page *f_page = list_entry(next_e, struct page, cp_elem);
-		enable_redundant_frame(f_page, page->frame);	// enable pml4
-	}
 	return lazy_load_segment(page, page->file.data);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* huge page(VM_HUGE)의 frame에 file 내용을 읽고 나머지는 0으로 채움
+ * data는 lazy_load_segment처럼 file_backed_destroy에서 삭제 */
+bool
+file_backed_load_huge (struct page *page, void *aux) {
+	struct lazy_load_data *data = aux;
+	void *kva = page->frame->kva;
+	ASSERT(page->type & VM_HUGE);
+
+	if (inode_read_at(data->inode, kva, data->readb, data->ofs) != (off_t) data->readb)
+		return false;
+	memset(kva + data->readb, 0, HPGSIZE - data->readb);
+	return true;
+}
+
+/* Swap out the page by writeback contents to the file.
+ * dirty인 mmap page만 기록, pml4에서 먼저 제거해서 기록 중 수정되지 않도록 함 */
 static bool
 file_backed_swap_out (struct page *page) {
 	ASSERT(page->frame && (page->type & VM_FRAME));
 	struct lazy_load_data *data = page->file.data;
+	struct frame *frame = page->frame;
+	void *kva = frame->kva;
+	bool writeback = (page->type & VM_MMAP) && file_page_is_dirty(page);
 
-	// isdirty
-	if ((page->type & VM_DIRTY) || pml4_is_dirty(page->pml4, page->va)) 
-		return true;
-
-	// not removed
-	if (!data->inode->removed) 
-		ASSERT(inode_write_at(data->inode, page->frame->kva, data->readb, data->ofs) == data->readb);
+	// no more sharing of this text page, pinned frame is not found by others
+	lock_acquire(&text_lock);
+	struct inode *inode = text_uncache(frame);
+	lock_release(&text_lock);
+	inode_close(inode);
 
 	// disable pml4 for pages which is sharing redundant frames
-	struct list_elem *next_e = &page->cp_elem; 
-	do {
-		struct page *f_page = list_entry(next_e, struct page, cp_elem);
+	struct page *f_page;
+	while ((f_page = frame->page) != NULL)
 		disable_redundant_frame(f_page);	
-	} while((next_e = list_next(next_e)) != &page->cp_elem);
+	page->type &= ~VM_DIRTY;
+
+	// not removed
+	if (writeback && !data->inode->removed)
+		write_dirty_sectors(page, kva);
 	
 	return true;
 }
 
+/* dirty인 mmap page를 file에 기록하고 clean으로 표시, page는 frame에 그대로 남음
+ * 기록 전에 dirty bit을 지워서 기록 중에 수정되면 다시 dirty가 되도록 함 */
+void
+file_backed_writeback (struct page *page) {
+	struct lazy_load_data *data = page->file.data;
+	if (!(page->type & VM_MMAP) || !(page->type & VM_FRAME) || !file_page_is_dirty(page))
+		return;
+
+	page->type &= ~VM_DIRTY;
+	struct frame *frame = page->frame;
+	lock_acquire(&frame->rmap_lock);
+	for (struct list_elem *e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e)) {
+		struct page *f_page = list_entry(e, struct page, rmap_elem);
+		pml4_set_dirty(f_page->pml4, f_page->va, false);
+	}
+	lock_release(&frame->rmap_lock);
+
+	if (!data->inode->removed)
+		write_dirty_sectors(page, page->frame->kva);
+}
+
+/* mmap page의 내용을 DISK_SECTOR_SIZE 단위로 hash해서 DATA에 기록
+ * file에서 읽은 직후 호출, 이후 write_dirty_sectors가 바뀐 sector를 찾는 기준 */
+void
+file_backed_hash_sectors (struct lazy_load_data *data, void *kva) {
+	for (size_t ofs = 0; ofs < data->readb; ofs += DISK_SECTOR_SIZE) {
+		size_t len = data->readb - ofs < DISK_SECTOR_SIZE ? data->readb - ofs : DISK_SECTOR_SIZE;
+		hash_bytes_128(kva + ofs, len, data->sector_hash[ofs / DISK_SECTOR_SIZE]);
+	}
+}
+
+/* dirty인 PAGE에서 바뀐 sector만 file에 기록하고 hash를 갱신
+ * 128bit hash로 비교해서 충돌로 쓰기를 잃을 확률은 무시할 수 있음
+ * 이어진 sector들은 한번에 기록, huge page는 hash가 없으므로 전부 기록 */
+static void
+write_dirty_sectors (struct page *page, void *kva) {
+	struct lazy_load_data *data = page->file.data;
+	size_t run_ofs = 0, run_len = 0;
+
+	if (page->type & VM_HUGE) {
+		write_sectors(data, kva, 0, data->readb);
+		return;
+	}
+	for (size_t ofs = 0; ofs < data->readb; ofs += DISK_SECTOR_SIZE) {
+		size_t len = data->readb - ofs < DISK_SECTOR_SIZE ? data->readb - ofs : DISK_SECTOR_SIZE;
+		uint64_t *saved = data->sector_hash[ofs / DISK_SECTOR_SIZE];
+		uint64_t hash[2];
+		hash_bytes_128(kva + ofs, len, hash);
+		if (hash[0] == saved[0] && hash[1] == saved[1]) {
+			write_sectors(data, kva, run_ofs, run_len);
+			run_len = 0;
+			continue;
+		}
+		saved[0] = hash[0];
+		saved[1] = hash[1];
+		if (run_len == 0)
+			run_ofs = ofs;
+		run_len += len;
+	}
+	write_sectors(data, kva, run_ofs, run_len);
+}
+
+/* page의 OFS부터 LEN byte를 file에 기록, LEN이 0이면 아무것도 안함 */
+static void
+write_sectors (struct lazy_load_data *data, void *kva, size_t ofs, size_t len) {
+	if (len == 0)
+		return;
+	off_t written = inode_write_at(data->inode, kva + ofs, len, data->ofs + ofs);
+	ASSERT(written == (off_t) len);
+}
+
+/* PAGE가 frame에 올라온 뒤 수정되었는지 확인 */
+static bool
+file_page_is_dirty (struct page *page) {
+	return (page->type & VM_DIRTY) || pml4_is_dirty(page->pml4, page->va);
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
@@ -85,10 +300,11 @@ static void delete_mmap_page(struct page *page) {
 		bool isdrity = (page->type & VM_DIRTY) || pml4_is_dirty(thread_current()->pml4, page->va); 
 		// not removed and drity
 		if ((page->type & VM_FRAME) && isdrity && data->inode && !data->inode->removed) 
-			ASSERT(inode_write_at(data->inode, page->frame->kva, data->readb, data->ofs) == data->readb);
+			write_dirty_sectors(page, page->frame->kva);
 		
 		// close inode and delete lazy load data
 		inode_close(data->inode);
 		free(data);
-	}
+	} else		// elf page keeps data to reload after eviction
+		free(data);
 }
\ No newline at end of file
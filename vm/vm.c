@@ -1,5 +1,7 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <string.h>
+#include <syscall-nr.h>
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
@@ -9,7 +11,15 @@
 
 static struct frame_table ftb;
 static struct hash cpy_mmap_list;
-static struct lock cp_lock; 		// for cp wrt
+static struct semaphore kswapd_sema;
+static bool kswapd_running;			// protected by frame_lock
+static bool kswapd_reclaim;			// low on frames, protected by frame_lock
+static bool kswapd_sync;			// msync(MS_ASYNC) frames, protected by frame_lock
+static void kswapd_wake (bool reclaim);
+static void vm_sync_frames (void);
+static void vm_kswapd (void *aux);
+static void *zero_kva;				// shared read only zero frame
+static bool vm_map_zero_page (struct page *page);
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -22,14 +32,43 @@ vm_init (void) {
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
-	hash_init(&ftb.frames, frame_hash, frame_less, NULL);
-	lock_init(&cp_lock);
+	list_init(&ftb.frames);
+	ftb.hand = list_end(&ftb.frames);
+	ftb.frame_cnt = 0;
+	lock_init(&ftb.frame_lock);
+	cond_init(&ftb.unpin_cond);
+	list_init(&ftb.free_frames);
+	ftb.free_cnt = 0;
+	sema_init(&kswapd_sema, 0);
+	kswapd_running = false;
+	kswapd_reclaim = false;
+	kswapd_sync = false;
+	zero_kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	thread_create("kswapd", PRI_DEFAULT, vm_kswapd, NULL);
 }
 
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_claim_with_frame (struct page *page, struct frame *frame);
+static void vm_fault_around (struct page *page, struct inode *inode, size_t ofs);
+static struct lazy_load_data *fault_around_data (struct page *page);
 static struct frame *vm_evict_frame (void);
+static size_t vm_get_anon_victims (struct frame *first, struct page **pages);
+static struct frame *clock_advance (void);
+static bool frame_test_and_clear_accessed (struct frame *frame);
+static void ftb_remove (struct frame *frame);
+static void ftb_insert (struct frame *frame);
+static void ftb_free_frame (struct frame *frame);
+static void vm_preclean (void);
+static struct frame *vm_pin_frame (struct page *page);
+static bool vm_map_frame (struct page *page);
+static struct page *spt_new_page (struct supplemental_page_table *spt, enum vm_type type,
+		void *upage, bool writable, vm_initializer *init, void *aux);
+static struct vma *vma_find (struct supplemental_page_table *spt, void *va);
+static struct page *vma_materialize (struct supplemental_page_table *spt, void *va);
+static void vma_free (struct vma *vma);
+static bool vma_map_huge (struct supplemental_page_table *spt, void *va);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -39,43 +78,50 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		vm_initializer *init, void *aux) {
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
-	struct thread *cur = thread_current();
-	struct supplemental_page_table *spt = &cur->spt;
+	struct supplemental_page_table *spt = &thread_current()->spt;
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
-		struct page *new_page = (struct page *) malloc(sizeof(struct page));
-		if (new_page == NULL)
-			return false;
-
-		bool (*initializer)(struct page *, enum vm_type, void *);
-		if (type & VM_ANON)
-			initializer = anon_initializer;
-		else if (type & VM_FILE)
-			initializer = file_backed_initializer;
-		else 
-			PANIC("Initializer not implemented ");
-
-		type = (writable & 1) ? type | VM_WRITABLE : type;
-		type = (type & VM_STACK) ? type |= VM_DIRTY : type;
-		uninit_new(new_page, pg_round_down(upage), init, type, aux, initializer);
-		circular_list_init(&new_page->cp_elem);
-		new_page->pml4 = cur->pml4;
-
-		/* TODO: Insert the page into the spt. */
-		return spt_insert_page(spt, new_page);
-	}	
+	if (spt_find_page (spt, upage) == NULL)
+		return spt_new_page(spt, type, upage, writable, init, aux) != NULL;
 err:
 	return false;
 }
 
+/* uninit page를 만들어 spt에 넣고 return, 실패시 NULL
+ * 자리가 비었는지는 호출한 쪽에서 확인 */
+static struct page *
+spt_new_page (struct supplemental_page_table *spt, enum vm_type type,
+		void *upage, bool writable, vm_initializer *init, void *aux) {
+	struct page *new_page = (struct page *) malloc(sizeof(struct page));
+	if (new_page == NULL)
+		return NULL;
+
+	bool (*initializer)(struct page *, enum vm_type, void *);
+	if (type & VM_ANON)
+		initializer = anon_initializer;
+	else if (type & VM_FILE)
+		initializer = file_backed_initializer;
+	else 
+		PANIC("Initializer not implemented ");
+
+	type = (writable & 1) ? type | VM_WRITABLE : type;
+	type = (type & VM_STACK) ? type |= VM_DIRTY : type;
+	uninit_new(new_page, pg_round_down(upage), init, type, aux, initializer);
+	new_page->pml4 = thread_current()->pml4;
+	new_page->vma = NULL;
+
+	if (!spt_insert_page(spt, new_page)) {
+		free(new_page);
+		return NULL;
+	}
+	return new_page;
+}
+
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt) {
 	hash_init(&spt->pages, page_hash, page_less, NULL);
+	list_init(&spt->vmas);
 }
 
 /* Find VA from spt and return page. On error, return NULL. */
@@ -85,9 +131,315 @@ spt_find_page (struct supplemental_page_table *spt, void *va) {
 	label_page.va = pg_round_down(va);
 	struct hash_elem *find_e = hash_find(&spt->pages, &label_page.hash_elem);
 	find_page = (find_e != NULL) ? hash_entry(find_e, struct page, hash_elem) : NULL;
+	if (find_page == NULL && spt == &thread_current()->spt)
+		find_page = vma_materialize(spt, label_page.va);
 	return find_page;
 }
 
+/* VA를 포함하는 영역을 return, 없으면 NULL */
+static struct vma *
+vma_find (struct supplemental_page_table *spt, void *va) {
+	struct list_elem *e;
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e)) {
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (va < vma->start)
+			break;
+		if (va < vma->end)
+			return vma;
+	}
+	return NULL;
+}
+
+/* VA가 속한 영역에서 아직 만들지 않은 page를 만들어 return, 영역 밖이면 NULL
+ * lazy_load_data는 영역의 file 위치에서 계산, mmap이면 page마다 inode를 열어둠 */
+static struct page *
+vma_materialize (struct supplemental_page_table *spt, void *va) {
+	struct vma *vma = vma_find(spt, va);
+	struct lazy_load_data *data;
+	struct page *page;
+	if (vma == NULL)
+		return NULL;
+	if (vma->huge) {		// chunk may be mapped by vma_map_huge
+		struct page label_page;
+		label_page.va = hpg_round_down(va);
+		struct hash_elem *e = hash_find(&spt->pages, &label_page.hash_elem);
+		if (e && (hash_entry(e, struct page, hash_elem)->type & VM_HUGE))
+			return hash_entry(e, struct page, hash_elem);
+	}
+	if (!(data = (struct lazy_load_data *) malloc(sizeof(struct lazy_load_data))))
+		return NULL;
+
+	size_t off = va - vma->start;
+	data->inode = vma->inode;
+	data->ofs = vma->ofs + off;
+	data->readb = 0;
+	if (off < vma->read_bytes)
+		data->readb = vma->read_bytes - off < PGSIZE ? vma->read_bytes - off : PGSIZE;
+	if (vma->type & VM_MMAP)
+		inode_reopen(vma->inode);
+
+	if (!(page = spt_new_page(spt, vma->type, va, vma->writable, lazy_load_segment, data))) {
+		if (vma->type & VM_MMAP)
+			inode_close(vma->inode);
+		free(data);
+		return NULL;
+	}
+	page->vma = vma;
+	list_push_back(&vma->pages, &page->vma_elem);
+	return page;
+}
+
+/* START부터 LENGTH byte의 영역을 page 없이 등록, 다른 영역이나 stack과 겹치면 false
+ * INODE의 OFS부터 READ_BYTES를 읽고 나머지는 0, mmap이면 INODE를 한번 더 열어둠 */
+bool
+vma_insert (struct supplemental_page_table *spt, enum vm_type type, void *start,
+		size_t length, bool writable, struct inode *inode, off_t ofs, size_t read_bytes) {
+	struct thread *cur = thread_current();
+	void *end = start + length;
+	struct list_elem *e;
+	struct vma *vma;
+
+	ASSERT(pg_ofs(start) == 0 && length % PGSIZE == 0);
+	if (end <= start)
+		return false;
+	if (cur->stack_bottom && end > (void *) cur->stack_bottom && start < (void *) USER_STACK)
+		return false;
+
+	// 정렬된 list에서 들어갈 자리를 찾으면서 겹치는지 확인
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e)) {
+		struct vma *next = list_entry(e, struct vma, elem);
+		if (next->end <= start)
+			continue;
+		if (next->start < end)
+			return false;
+		break;
+	}
+	if (!(vma = (struct vma *) malloc(sizeof(struct vma))))
+		return false;
+
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->writable = writable;
+	vma->inode = (type & VM_MMAP) ? inode_reopen(inode) : inode;
+	vma->ofs = ofs;
+	vma->read_bytes = read_bytes;
+	vma->advice = MADV_NORMAL;
+	vma->huge = false;
+	list_init(&vma->pages);
+	list_insert(e, &vma->elem);
+	return true;
+}
+
+/* VA가 MADV_HUGEPAGE인 mmap 영역 안의 HPGSIZE 단위에 속하면 그 단위를 한번에 올려서
+ * pde 하나로 mapping, 연속된 frame은 ftb에 넣지 않아 evict되지 않음
+ * 단위 안에 이미 page가 있거나, user pool에 여유가 없거나, 읽기에 실패하면 false,
+ * 이때는 4KiB page로 처리 */
+static bool
+vma_map_huge (struct supplemental_page_table *spt, void *va) {
+	struct vma *vma = vma_find(spt, va);
+	void *upage = hpg_round_down(va);
+	if (!vma || !vma->huge || upage < vma->start || upage + HPGSIZE > vma->end)
+		return false;
+	for (struct list_elem *p = list_begin(&vma->pages); p != list_end(&vma->pages); p = list_next(p)) {
+		struct page *page = list_entry(p, struct page, vma_elem);
+		if (page->va >= upage && page->va < upage + HPGSIZE)
+			return false;
+	}
+	// huge frames are never evicted, keep as much again for 4KiB frames
+	if (palloc_free_cnt(PAL_USER) < HUGE_FREE_MIN)
+		return false;
+
+	size_t off = upage - vma->start;
+	struct lazy_load_data *data = malloc(sizeof(struct lazy_load_data));
+	struct frame *frame = malloc(sizeof(struct frame));
+	void *kva = palloc_get_huge(PAL_USER);
+	struct page *page = NULL;
+
+	if (data && frame && kva) {
+		data->inode = inode_reopen(vma->inode);
+		data->ofs = vma->ofs + off;
+		data->readb = 0;
+		if (off < vma->read_bytes)
+			data->readb = vma->read_bytes - off < HPGSIZE ? vma->read_bytes - off : HPGSIZE;
+		page = spt_new_page(spt, vma->type | VM_HUGE, upage, vma->writable,
+							file_backed_load_huge, data);
+		if (page == NULL)
+			inode_close(data->inode);
+	}
+	if (page == NULL) {
+		free(data);
+		free(frame);
+		if (kva)
+			palloc_free_multiple(kva, HPG_PAGES);
+		return false;
+	}
+	page->vma = vma;
+	list_push_back(&vma->pages, &page->vma_elem);
+
+	memset(frame, 0, sizeof(struct frame));
+	frame->kva = kva;
+	list_init(&frame->rmap);
+	lock_init(&frame->rmap_lock);
+	frame_rmap_add(frame, page);
+	// page becomes file page even if read fails, destroy frees the frame
+	if (!swap_in(page, kva)
+			|| !pml4_set_huge_page(page->pml4, upage, kva, vma->writable)) {
+		spt_remove_page(spt, page);
+		return false;
+	}
+	return true;
+}
+
+/* START에서 시작하는 mmap 영역과 만들어진 page들을 삭제, 없으면 false */
+bool
+vma_remove_mmap (struct supplemental_page_table *spt, void *start) {
+	struct vma *vma = vma_find(spt, start);
+	if (vma == NULL || vma->start != start || !(vma->type & VM_MMAP))
+		return false;
+
+	while (!list_empty(&vma->pages)) {
+		struct page *page = list_entry(list_front(&vma->pages), struct page, vma_elem);
+		spt_remove_page(spt, page);
+	}
+	list_remove(&vma->elem);
+	vma_free(vma);
+	return true;
+}
+
+/* ADDR부터 LENGTH byte가 빈틈없이 영역들 안에 있으면 true, MMAP이면 mmap 영역만 허용 */
+static bool
+vma_covers (struct supplemental_page_table *spt, void *addr, size_t length, bool mmap) {
+	void *end = addr + length;
+	if (pg_ofs(addr) || length == 0 || end < addr)
+		return false;
+
+	for (struct list_elem *e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e)) {
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->end <= addr)
+			continue;
+		if (vma->start > addr || (mmap && !(vma->type & VM_MMAP)))
+			return false;
+		addr = vma->end;
+		if (addr >= end)
+			return true;
+	}
+	return false;
+}
+
+/* ADDR부터 LENGTH byte의 mmap page 중 dirty인 page를 file에 기록, 범위가 잘못되면 false
+ * MS_ASYNC면 frame에 표시하고 kswapd가 기록, huge page는 항상 바로 기록 */
+bool
+vma_msync (struct supplemental_page_table *spt, void *addr, size_t length, int flags) {
+	void *end = addr + length;
+	bool wake = false;
+	if ((flags & ~(MS_ASYNC | MS_SYNC)) || flags == (MS_ASYNC | MS_SYNC)
+			|| !vma_covers(spt, addr, length, true))
+		return false;
+
+	for (struct list_elem *e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e)) {
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->start >= end)
+			break;
+		if (vma->end <= addr)
+			continue;
+		for (struct list_elem *p = list_begin(&vma->pages); p != list_end(&vma->pages); p = list_next(p)) {
+			struct page *page = list_entry(p, struct page, vma_elem);
+			void *page_end = page->va + ((page->type & VM_HUGE) ? HPGSIZE : PGSIZE);
+			if (page_end <= addr || page->va >= end)
+				continue;
+			if (!(flags & MS_SYNC) && !(page->type & VM_HUGE)) {
+				lock_acquire(&ftb.frame_lock);
+				if (page->frame) {
+					page->frame->sync = true;
+					wake = true;
+				}
+				lock_release(&ftb.frame_lock);
+				continue;
+			}
+			struct frame *frame = vm_pin_frame(page);
+			if (frame) {
+				file_backed_writeback(page);
+				vm_frame_unpin(frame);
+			}
+		}
+	}
+	if (wake) {
+		lock_acquire(&ftb.frame_lock);
+		kswapd_wake(false);
+		lock_release(&ftb.frame_lock);
+	}
+	return true;
+}
+
+/* ADDR부터 LENGTH byte에 대한 ADVICE를 반영, 범위가 영역 밖이면 false
+ * NORMAL, RANDOM, SEQUENTIAL은 겹치는 영역 전체의 read-around와 evict 정책을 바꾸고
+ * WILLNEED는 file page를 evict 없이 얻을 수 있는 만큼 미리 올리고,
+ * DONTNEED는 page를 삭제해서 다음 접근 때 영역에서 다시 만들도록 함(겹치는 huge page는 통째로),
+ * HUGEPAGE는 mmap 영역의 아직 만들지 않은 HPGSIZE 단위를 접근할 때 huge page로 올리게 함 */
+bool
+vma_madvise (struct supplemental_page_table *spt, void *addr, size_t length, int advice) {
+	void *end = addr + length;
+	if (advice < MADV_NORMAL || advice > MADV_HUGEPAGE || !vma_covers(spt, addr, length, false))
+		return false;
+
+	for (struct list_elem *e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e)) {
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->start >= end)
+			break;
+		if (vma->end <= addr)
+			continue;
+		if (advice <= MADV_SEQUENTIAL)
+			vma->advice = advice;
+		if (advice == MADV_HUGEPAGE && (vma->type & VM_MMAP))
+			vma->huge = true;
+		if (advice != MADV_DONTNEED)
+			continue;
+
+		struct list_elem *p = list_begin(&vma->pages);
+		while (p != list_end(&vma->pages)) {
+			struct page *page = list_entry(p, struct page, vma_elem);
+			p = list_next(p);
+			void *page_end = page->va + ((page->type & VM_HUGE) ? HPGSIZE : PGSIZE);
+			if (page_end > addr && page->va < end)
+				spt_remove_page(spt, page);
+		}
+	}
+
+	for (void *va = addr; advice == MADV_WILLNEED && va < end; va += PGSIZE) {
+		struct page *page = spt_find_page(spt, va);
+		if (!page || !fault_around_data(page) || file_backed_share_text(page))
+			continue;
+		struct frame *frame = vm_get_free_frame();
+		if (!frame || !vm_claim_with_frame(page, frame))
+			break;
+	}
+	return true;
+}
+
+/* exec에서 살려둘 mmap 영역들을 순서대로 MMAPS로 옮김 */
+void
+vma_take_mmap (struct supplemental_page_table *spt, struct list *mmaps) {
+	struct list_elem *e = list_begin(&spt->vmas);
+	while (e != list_end(&spt->vmas)) {
+		struct vma *vma = list_entry(e, struct vma, elem);
+		e = list_next(e);
+		if (vma->type & VM_MMAP) {
+			list_remove(&vma->elem);
+			list_push_back(mmaps, &vma->elem);
+		}
+	}
+}
+
+/* page가 모두 삭제된 영역을 해제 */
+static void
+vma_free (struct vma *vma) {
+	ASSERT(list_empty(&vma->pages));
+	if (vma->type & VM_MMAP)
+		inode_close(vma->inode);
+	free(vma);
+}
+
 /* Insert PAGE into spt with validation. */
 bool
 spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
@@ -104,94 +456,431 @@ spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* hand가 가리키는 frame을 return하고 hand를 다음 frame으로 옮김, ring 끝이면 처음으로 */
+static struct frame *
+clock_advance (void) {
+	if (ftb.hand == list_end(&ftb.frames))
+		ftb.hand = list_begin(&ftb.frames);
+	struct frame *nframe = list_entry(ftb.hand, struct frame, elem);
+	ftb.hand = list_next(ftb.hand);
+	return nframe;
+}
+
+/* frame을 공유하는 모든 page의 pml4에서 accessed bit을 확인하고 지움
+ * 하나라도 접근했으면 true */
+static bool
+frame_test_and_clear_accessed (struct frame *frame) {
+	bool accessed = false;
+	lock_acquire(&frame->rmap_lock);
+	for (struct list_elem *e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e)) {
+		struct page *f_page = list_entry(e, struct page, rmap_elem);
+		if (VM_TYPE(f_page->type) & VM_ANON)
+			anon_prefetch_account(f_page);
+		if (pml4_is_accessed(f_page->pml4, f_page->va)) {
+			pml4_set_accessed(f_page->pml4, f_page->va, false);
+			// sequentially read page is not used again, let it go first
+			if (!f_page->vma || f_page->vma->advice != MADV_SEQUENTIAL)
+				accessed = true;
+		}
+	}
+	lock_release(&frame->rmap_lock);
+	return accessed;
+}
+
+/* FRAME을 ring에서 제거, hand가 가리키고 있으면 다음 frame으로 옮김
+ * frame_lock을 잡은 상태로 호출 */
+static void
+ftb_remove (struct frame *frame) {
+	if (ftb.hand == &frame->elem)
+		ftb.hand = list_next(ftb.hand);
+	list_remove(&frame->elem);
+	ftb.frame_cnt--;
+}
+
+/* FRAME을 hand 바로 뒤에 넣어 가장 늦게 확인되도록 함, frame_lock을 잡은 상태로 호출 */
+static void
+ftb_insert (struct frame *frame) {
+	list_insert(ftb.hand, &frame->elem);
+	ftb.frame_cnt++;
+}
+
+/* evict된 FRAME을 ring에서 빼서 free_frames에 넣음, frame_lock을 잡은 상태로 호출 */
+static void
+ftb_free_frame (struct frame *frame) {
+	ASSERT(frame->ref_cnt == 0);
+	ftb_remove(frame);
+	frame->page = NULL;
+	frame->pinned = false;
+	list_push_back(&ftb.free_frames, &frame->elem);
+	ftb.free_cnt++;
+}
+
+/* Get the struct frame, that will be evicted.
+ * hand를 유지하는 clock algorithm, 한바퀴 돌면 accessed bit이 모두 지워지므로
+ * 최대 두바퀴 안에 victim을 찾음, 모두 pinned면 NULL
+ * frame_lock을 잡은 상태로 호출, victim은 pinned로 return */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *nframe, *victim = NULL;
 	/* TODO: The policy for eviction is up to you. */
-	struct hash_iterator i;
-	bool not_sharing_frame = false;
-	struct thread *cur = thread_current();
-	hash_first(&i, &ftb.frames);
-	while (victim == NULL) {
-		while (victim == NULL) {
-			if (!hash_next(&i)){
-				hash_first(&i, &ftb.frames);
-				hash_next(&i);
-			}
-
-			nframe = hash_entry(hash_cur(&i), struct frame, hash_elem);
-			/* using clock algorithm */
-			if (pml4_is_accessed(cur->pml4, nframe->page->va))
-				pml4_set_accessed(cur->pml4, nframe->page->va, false);
-			else if (not_sharing_frame || !is_alone(&nframe->page->cp_elem)) {
-				victim = nframe;
-			} else {
-				victim = nframe;
-			}
+	if (ftb.frame_cnt == 0)
+		return NULL;
+	for (size_t i = 0; i < 2 * ftb.frame_cnt + 1; i++) {
+		struct frame *nframe = clock_advance();
+		if (nframe->pinned || nframe->page == NULL)
+			continue;
+		if (!frame_test_and_clear_accessed(nframe)) {
+			nframe->pinned = true;
+			return nframe;
 		}
-		not_sharing_frame = true;
 	}
-	return victim;
+	return NULL;
+}
+
+/* anon victim과 함께 swap out할 anon page들을 hand부터 이어서 모아서
+ * FIRST의 page를 포함해 최대 SWAP_BATCH개를 PAGES에 담고 개수 return
+ * 최근에 접근한 frame을 만나면 기회를 한번 더 주고 멈춤
+ * frame_lock을 잡은 상태로 호출, 모은 frame은 pinned */
+static size_t
+vm_get_anon_victims (struct frame *first, struct page **pages) {
+	size_t cnt = 0;
+
+	pages[cnt++] = first->page;
+	while (cnt < SWAP_BATCH && ftb.hand != list_end(&ftb.frames)) {
+		struct frame *nframe = list_entry(ftb.hand, struct frame, elem);
+		struct page *page = nframe->page;
+		if (nframe == first || nframe->pinned || !page || page->operations->type != VM_ANON
+				|| !(page->type & VM_FRAME) || page->frame != nframe)
+			break;
+		if (frame_test_and_clear_accessed(nframe))
+			break;
+		ftb.hand = list_next(ftb.hand);
+		nframe->pinned = true;
+		pages[cnt++] = page;
+	}
+	return cnt;
 }
 
 /* Evict one page and return the corresponding frame.
+ * anon page인 경우 다른 anon page들과 묶어서 한번에 swap out하고
+ * 남은 frame들은 free_frames에 넣어 다음 vm_get_frame에서 사용
+ * disk에 쓰는 동안에는 frame_lock을 놓고, victim들은 pinned로 보호
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
+	lock_acquire(&ftb.frame_lock);
 	struct frame *victim = vm_get_victim ();
-	if (!swap_out(victim->page))
+	if (victim == NULL) {
+		lock_release(&ftb.frame_lock);
 		return NULL;
+	}
+	if (victim->page->operations->type != VM_ANON) {
+		lock_release(&ftb.frame_lock);
+		if (!swap_out(victim->page)) {
+			vm_frame_unpin(victim);
+			return NULL;
+		}
+		return victim;
+	}
+
+	struct page *pages[SWAP_BATCH];
+	struct frame *frames[SWAP_BATCH];
+	size_t cnt = vm_get_anon_victims(victim, pages);
+	for (size_t i = 0; i < cnt; i++)
+		frames[i] = pages[i]->frame;
+	lock_release(&ftb.frame_lock);
+
+	if (!anon_swap_out_batch(pages, cnt)) {
+		for (size_t i = 0; i < cnt; i++)
+			vm_frame_unpin(frames[i]);
+		return NULL;
+	}
+
+	lock_acquire(&ftb.frame_lock);
+	for (size_t i = 1; i < cnt; i++)
+		ftb_free_frame(frames[i]);
+	cond_broadcast(&ftb.unpin_cond, &ftb.frame_lock);
+	lock_release(&ftb.frame_lock);
 	return victim;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ * kswapd가 채워둔 frame이 없을 때만 직접 evict, return한 frame은 pinned */
 static struct frame *
 vm_get_frame (void) {
 	struct frame *frame;
-	void *kva = palloc_get_page(PAL_USER);
-	if (kva != NULL){
-		frame = (struct frame *) calloc(1, sizeof(struct frame));
-		if (!frame)
-			return NULL;
-		frame->kva = kva;
-		hash_insert(&ftb.frames, &frame->hash_elem);
-	} else 
-		frame = vm_evict_frame();
+	while ((frame = vm_get_free_frame()) == NULL) {
+		if ((frame = vm_evict_frame()) != NULL)
+			break;
+		thread_yield();		// every frame is pinned
+	}
 	
 	ASSERT (frame != NULL);
 	return frame;
 }
 
-/* Handle the fault on write_protected page */
+/* evict 하지 않고 얻을 수 있는 frame return, 없으면 NULL
+ * user pool이 부족해지면 kswapd를 깨움, return한 frame은 pinned */
+struct frame *
+vm_get_free_frame (void) {
+	struct frame *frame = NULL;
+	void *kva = NULL;
+	bool wake;
+
+	lock_acquire(&ftb.frame_lock);
+	if (!list_empty(&ftb.free_frames)) {	// reclaimed by kswapd or batch
+		frame = list_entry(list_pop_front(&ftb.free_frames), struct frame, elem);
+		ftb.free_cnt--;
+		wake = ftb.free_cnt < FREE_FRAMES_LOW;
+	} else {
+		kva = palloc_get_page(PAL_USER);
+		wake = kva == NULL;
+		if (kva && !(frame = (struct frame *) calloc(1, sizeof(struct frame)))) {
+			palloc_free_page(kva);
+			kva = NULL;
+		}
+		if (frame) {
+			frame->kva = kva;
+			list_init(&frame->rmap);
+			lock_init(&frame->rmap_lock);
+		}
+	}
+	if (frame) {
+		frame->page = NULL;
+		frame->pinned = true;
+		frame->sync = false;
+		ftb_insert(frame);		// behind hand, checked last
+	}
+	if (wake)
+		kswapd_wake(true);
+	lock_release(&ftb.frame_lock);
+	return frame;
+}
+
+/* kswapd를 깨움, RECLAIM이면 frame을 회수하고 아니면 msync된 frame만 기록
+ * 실행 중이면 끝난 뒤 다시 돌도록 표시만 함, frame_lock을 잡은 상태로 호출 */
+static void
+kswapd_wake (bool reclaim) {
+	if (reclaim)
+		kswapd_reclaim = true;
+	else
+		kswapd_sync = true;
+	if (!kswapd_running) {
+		kswapd_running = true;
+		sema_up(&kswapd_sema);
+	}
+}
+
+/* claim이나 evict가 끝난 frame을 clock이 다시 고를 수 있도록 함 */
+void
+vm_frame_unpin (struct frame *frame) {
+	lock_acquire(&ftb.frame_lock);
+	frame->pinned = false;
+	cond_broadcast(&ftb.unpin_cond, &ftb.frame_lock);
+	lock_release(&ftb.frame_lock);
+}
+
+/* FRAME이 사용 중이고 pin되어 있지 않으면 pin하고 true, 아니면 기다리지 않고 false */
+bool
+vm_frame_try_pin (struct frame *frame) {
+	bool succ;
+	lock_acquire(&ftb.frame_lock);
+	succ = !frame->pinned && frame->page != NULL;
+	if (succ)
+		frame->pinned = true;
+	lock_release(&ftb.frame_lock);
+	return succ;
+}
+
+/* PAGE의 frame이 evict되는 중이면 끝날 때까지 기다림 */
+void
+vm_wait_unpinned (struct page *page) {
+	lock_acquire(&ftb.frame_lock);
+	while (page->frame && page->frame->pinned)
+		cond_wait(&ftb.unpin_cond, &ftb.frame_lock);
+	lock_release(&ftb.frame_lock);
+}
+
+/* PAGE의 frame을 pin해서 evict되지 않도록 하고 return, frame에 없으면 NULL */
+static struct frame *
+vm_pin_frame (struct page *page) {
+	lock_acquire(&ftb.frame_lock);
+	while (page->frame && page->frame->pinned)
+		cond_wait(&ftb.unpin_cond, &ftb.frame_lock);
+	struct frame *frame = page->frame;
+	if (frame)
+		frame->pinned = true;
+	lock_release(&ftb.frame_lock);
+	return frame;
+}
+
+/* PAGE를 FRAME의 reverse map에 추가하고 frame에 연결 */
+void
+frame_rmap_add (struct frame *frame, struct page *page) {
+	lock_acquire(&frame->rmap_lock);
+	list_push_back(&frame->rmap, &page->rmap_elem);
+	frame->ref_cnt++;
+	if (frame->page == NULL)
+		frame->page = page;
+	page->frame = frame;
+	page->type |= VM_FRAME;
+	lock_release(&frame->rmap_lock);
+}
+
+/* PAGE를 FRAME의 reverse map에서 제거하고 남은 참조 수 return
+ * frame->page였다면 남은 page에게 넘겨줌, pml4는 호출한 쪽에서 정리 */
+size_t
+frame_rmap_remove (struct frame *frame, struct page *page) {
+	lock_acquire(&frame->rmap_lock);
+	ASSERT(page->frame == frame && frame->ref_cnt > 0);
+	list_remove(&page->rmap_elem);
+	size_t ref_cnt = --frame->ref_cnt;
+	if (frame->page == page)
+		frame->page = ref_cnt ? list_entry(list_front(&frame->rmap), struct page, rmap_elem) : NULL;
+	page->frame = NULL;
+	page->type &= ~VM_FRAME;
+	lock_release(&frame->rmap_lock);
+	return ref_cnt;
+}
+
+/* Background reclaim daemon, user pool이 부족해지면 깨어나서
+ * free_frames가 FREE_FRAMES_HIGH가 될 때까지 evict하고
+ * hand 앞쪽의 dirty mmap page들을 미리 기록해둠, msync(MS_ASYNC)된 page도 기록 */
+static void
+vm_kswapd (void *aux UNUSED) {
+	for (;;) {
+		sema_down(&kswapd_sema);
+		lock_acquire(&ftb.frame_lock);
+		bool reclaim = kswapd_reclaim, sync = kswapd_sync;
+		kswapd_reclaim = kswapd_sync = false;
+		lock_release(&ftb.frame_lock);
+
+		while (reclaim && ftb.free_cnt < FREE_FRAMES_HIGH) {
+			struct frame *victim = vm_evict_frame();
+			if (victim == NULL)
+				break;
+			lock_acquire(&ftb.frame_lock);
+			ftb_free_frame(victim);
+			cond_broadcast(&ftb.unpin_cond, &ftb.frame_lock);
+			lock_release(&ftb.frame_lock);
+		}
+		if (reclaim)
+			vm_preclean();
+		if (sync)
+			vm_sync_frames();
+
+		lock_acquire(&ftb.frame_lock);
+		if (kswapd_reclaim || kswapd_sync)		// woken again while running
+			sema_up(&kswapd_sema);
+		else
+			kswapd_running = false;
+		lock_release(&ftb.frame_lock);
+	}
+}
+
+/* msync(MS_ASYNC)로 표시된 frame의 dirty mmap page를 PRECLEAN_SCAN개씩 file에 기록
+ * pinned인 frame은 표시를 남겨두고 다음에 깨어났을 때 기록 */
+static void
+vm_sync_frames (void) {
+	struct page *pages[PRECLEAN_SCAN];
+	size_t cnt;
+
+	do {
+		cnt = 0;
+		lock_acquire(&ftb.frame_lock);
+		for (struct list_elem *e = list_begin(&ftb.frames);
+				e != list_end(&ftb.frames) && cnt < PRECLEAN_SCAN; e = list_next(e)) {
+			struct frame *nframe = list_entry(e, struct frame, elem);
+			struct page *page = nframe->page;
+			if (!nframe->sync || nframe->pinned)
+				continue;
+			nframe->sync = false;
+			if (!page || !(page->type & VM_MMAP) || !(page->type & VM_FRAME))
+				continue;
+			nframe->pinned = true;
+			pages[cnt++] = page;
+		}
+		lock_release(&ftb.frame_lock);
+
+		for (size_t i = 0; i < cnt; i++) {
+			struct frame *frame = pages[i]->frame;
+			file_backed_writeback(pages[i]);
+			vm_frame_unpin(frame);
+		}
+	} while (cnt == PRECLEAN_SCAN);
+}
+
+/* hand 앞쪽 PRECLEAN_SCAN개의 frame 중 최근에 접근하지 않은 dirty mmap page는 file에,
+ * 공유하지 않는 dirty anon page는 SWAP_BATCH개까지 swap에 기록해서
+ * 나중에 evict할 때 기록 없이 바로 내보낼 수 있도록 함 */
+static void
+vm_preclean (void) {
+	struct page *pages[PRECLEAN_SCAN];
+	struct page *anons[SWAP_BATCH];
+	size_t cnt = 0, anon_cnt = 0;
+
+	lock_acquire(&ftb.frame_lock);
+	struct list_elem *e = ftb.hand;
+	for (size_t i = 0; i < PRECLEAN_SCAN && i < ftb.frame_cnt; i++, e = list_next(e)) {
+		if (e == list_end(&ftb.frames))
+			e = list_begin(&ftb.frames);
+		struct frame *nframe = list_entry(e, struct frame, elem);
+		struct page *page = nframe->page;
+		if (nframe->pinned || !page || !(page->type & VM_FRAME)
+				|| pml4_is_accessed(page->pml4, page->va))
+			continue;
+		if (page->type & VM_MMAP) {
+			nframe->pinned = true;
+			pages[cnt++] = page;
+		} else if (VM_TYPE(page->type) == (VM_FRAME | VM_ANON) && nframe->ref_cnt == 1
+				&& anon_cnt < SWAP_BATCH && !(page->type & VM_SWAPCACHE)
+				&& ((page->type & (VM_DIRTY | VM_BSS)) || pml4_is_dirty(page->pml4, page->va))) {
+			nframe->pinned = true;
+			anons[anon_cnt++] = page;
+		}
+	}
+	lock_release(&ftb.frame_lock);
+
+	for (size_t i = 0; i < cnt; i++) {
+		struct frame *frame = pages[i]->frame;
+		file_backed_writeback(pages[i]);
+		vm_frame_unpin(frame);
+	}
+	anon_preclean(anons, anon_cnt);
+	for (size_t i = 0; i < anon_cnt; i++)
+		vm_frame_unpin(anons[i]->frame);
+}
+
+/* Handle the fault on write_protected page
+ * frame의 참조가 하나뿐이면 그대로 쓰기 허용, 아니면 복사해서 reverse map을 옮김 */
 static bool
 vm_handle_wp (struct page *page) {
 	struct thread *cur = thread_current();
-	if (!(page->type & (VM_CPWRITE || VM_WRITABLE)))
+	if ((page->type & (VM_CPWRITE | VM_WRITABLE)) != (VM_CPWRITE | VM_WRITABLE))
 		return false;
 	page->type &= ~VM_CPWRITE;
 	page->type |= VM_DIRTY;
-	lock_acquire(&cp_lock);
-	// cp on wrt
-	if (is_alone(&page->cp_elem)){		// use frame alone
-		lock_release(&cp_lock);
-		if (!pml4_set_page(cur->pml4, page->va, page->frame->kva, 1))
-			return false;
-		return true;
+
+	struct frame *old_frame = vm_pin_frame(page);
+	if (old_frame == NULL)		// evicted meanwhile, swap in private frame
+		return vm_do_claim_page(page);
+
+	// cp on wrt, sharers only leave while pinned so a stale count just copies
+	if (old_frame->ref_cnt == 1) {		// use frame alone
+		bool succ = pml4_set_page(cur->pml4, page->va, old_frame->kva, 1);
+		vm_frame_unpin(old_frame);
+		return succ;
 	}
-	list_remove(&page->cp_elem); 	// delete redundant refer
 	struct frame *new_frame = vm_get_frame();
-	lock_release(&cp_lock);	
-	memcpy(new_frame->kva, page->frame->kva, PGSIZE);
-	page->frame = new_frame;
-	new_frame->page = page;
-	if (!pml4_set_page(cur->pml4, page->va, new_frame->kva, 1))
-		return false;
-	
-	return true;	
+	memcpy(new_frame->kva, old_frame->kva, PGSIZE);
+	frame_rmap_remove(old_frame, page);
+	frame_rmap_add(new_frame, page);
+	bool succ = pml4_set_page(cur->pml4, page->va, new_frame->kva, 1);
+	vm_frame_unpin(new_frame);
+	vm_frame_unpin(old_frame);
+	return succ;
 }
 
 // check rsp in PGSIZE down from last rsp(simple is best!)
@@ -241,9 +930,29 @@ vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		return true;
 	}
 
+	// first touch of a chunk in MADV_HUGEPAGE region
+	if (not_present && vma_map_huge(&cur->spt, addr))
+		return true;
+
 	if (!(page = spt_find_page(&cur->spt, addr)))
 		return false;
 
+	// page is being evicted by kswapd or other process
+	vm_wait_unpinned(page);
+
+	// first write on zero page, NOSWAP gives zero filled private frame
+	if (page->type & VM_ZERO) {
+		if (!write)
+			return false;
+		page->type &= ~VM_ZERO;
+		pml4_clear_page(page->pml4, page->va);
+		goto end;
+	}
+
+	// read on never written anon page
+	if (not_present && !write && vm_map_zero_page(page))
+		return true;
+
 	if (!not_present && page->operations->type == VM_UNINIT)	// lazy load
 		goto end;
 	
@@ -251,6 +960,8 @@ vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 	{
 	case (VM_FRAME | VM_FILE):
 	case (VM_FRAME | VM_ANON):
+		if (not_present)		// shared by fork, not in child's pml4 yet
+			return vm_map_frame(page);
 		if (write && vm_handle_wp(page)) 
 			return true;
 		
@@ -267,58 +978,212 @@ vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 end:
 	if (write)
 		page->type |= VM_DIRTY;
-	return vm_do_claim_page (page);
+	// bss data is freed by lazy load, remember file position first
+	struct lazy_load_data *data = not_present ? fault_around_data(page) : NULL;
+	struct inode *inode = data ? data->inode : NULL;
+	size_t ofs = data ? data->ofs : 0;
+	if (!vm_do_claim_page (page))
+		return false;
+	if (inode)
+		vm_fault_around(page, inode, ofs);
+	return true;
+}
+
+/* file에서 읽어오는 page면 lazy_load_data return, 이미 올라와 있거나 아니면 NULL
+ * elf의 text, data와 mmap page가 해당, 전부 0인 bss는 zero page로 처리 */
+static struct lazy_load_data *
+fault_around_data (struct page *page) {
+	struct lazy_load_data *data;
+	if (page->operations->type == VM_UNINIT) {
+		if (page->uninit.init != lazy_load_segment)
+			return NULL;
+		data = page->uninit.aux;
+	} else if (page->operations->type == VM_FILE && !(page->type & VM_FRAME))
+		data = page->file.data;
+	else
+		return NULL;
+	return (data && data->inode && data->readb) ? data : NULL;
+}
+
+/* INODE의 OFS에서 읽어온 PAGE 뒤로 file에서도 이어지는 page들을 FAULT_AROUND_PAGES개까지 함께 올림
+ * 이어지지 않거나 evict 없이 frame을 얻을 수 없으면 멈춤 */
+static void
+vm_fault_around (struct page *page, struct inode *inode, size_t ofs) {
+	struct thread *cur = thread_current();
+	int advice = page->vma ? page->vma->advice : MADV_NORMAL;
+	size_t around = (advice == MADV_SEQUENTIAL) ? 2 * FAULT_AROUND_PAGES : FAULT_AROUND_PAGES;
+
+	if (advice == MADV_RANDOM)
+		return;
+	for (size_t i = 1; i < around; i++) {
+		struct page *n_page = spt_find_page(&cur->spt, page->va + i * PGSIZE);
+		struct lazy_load_data *n_data = n_page ? fault_around_data(n_page) : NULL;
+		if (!n_data || n_data->inode != inode || n_data->ofs != ofs + i * PGSIZE)
+			break;
+		if (file_backed_share_text(n_page))
+			continue;
+
+		struct frame *frame = vm_get_free_frame();
+		if (!frame || !vm_claim_with_frame(n_page, frame))
+			break;
+	}
+}
+
+/* 한번도 쓰지 않은 anon page(전부 0인 bss, 내용 없이 evict된 page)를
+ * 공유 zero frame에 읽기 전용으로 mapping, 해당하지 않으면 false
+ * 처음 쓸 때 vm_try_handle_fault에서 private frame을 할당 */
+static bool
+vm_map_zero_page (struct page *page) {
+	if (page->operations->type == VM_UNINIT) {
+		struct lazy_load_data *data = page->uninit.aux;
+		if (!(page->type & VM_BSS) || page->uninit.init != lazy_load_segment || data->readb)
+			return false;
+		// transmute to anon without frame, bss initializer touches no frame
+		if (!page->uninit.page_initializer(page, page->type, NULL))
+			return false;
+		free(data);
+	} else if (page->operations->type != VM_ANON || !(page->type & VM_NOSWAP)
+			|| (page->type & VM_FRAME))
+		return false;
+
+	if (!pml4_set_page(page->pml4, page->va, zero_kva, false))
+		return false;
+	page->type |= VM_ZERO | VM_NOSWAP;
+	return true;
+}
+
+/* kernel이 PAGE에 쓰기 전에 zero page mapping이나 fork로 공유한 frame을 끊고 private frame을 올림
+ * CR0.WP가 꺼져 있어 kernel의 쓰기는 읽기 전용 pte에서 fault 없이 공유 frame을 바꿈 */
+bool
+vm_unshare_page (struct page *page) {
+	vm_wait_unpinned(page);
+	if (page->type & VM_ZERO) {		// same as first write fault
+		page->type &= ~VM_ZERO;
+		page->type |= VM_DIRTY;
+		pml4_clear_page(page->pml4, page->va);
+		return vm_do_claim_page(page);
+	}
+	if ((page->type & (VM_FRAME | VM_CPWRITE)) == (VM_FRAME | VM_CPWRITE))
+		return vm_handle_wp(page);
+	return true;
 }
 
 /* Claim the page that allocate on VA. */
 bool
 vm_claim_page (void *va) {
+	if (vma_map_huge(&thread_current()->spt, va))
+		return true;
 	struct page *page = spt_find_page(&thread_current()->spt, va);
 	if (page == NULL)
 		return false;
+	if (page->type & VM_FRAME)		// shared by fork, not in child's pml4 yet
+		return pml4_get_page(page->pml4, page->va) || vm_map_frame(page);
 	return vm_do_claim_page (page);
 }
 
+/* fork로 frame을 공유하게 된 PAGE나 exec에서 넘겨받은 page를 처음 접근할 때 pml4에 mapping
+ * cpwrite면 읽기 전용으로 두고 쓸 때 vm_handle_wp에서 복사, 그 사이 evict되었으면 swap in */
+static bool
+vm_map_frame (struct page *page) {
+	struct frame *frame = vm_pin_frame(page);
+	if (frame == NULL)
+		return vm_do_claim_page(page);
+	bool writable = (page->type & (VM_WRITABLE | VM_CPWRITE)) == VM_WRITABLE;
+	bool succ = (page->type & VM_HUGE)
+		? pml4_set_huge_page(page->pml4, page->va, frame->kva, writable)
+		: pml4_set_page(page->pml4, page->va, frame->kva, writable);
+	vm_frame_unpin(frame);
+	return succ;
+}
+
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	if (file_backed_share_text(page))		// elf text already loaded by others
+		return true;
 
-	/* Set links */
-	page->frame = frame;
-	frame->page = page;
+	return vm_claim_with_frame(page, vm_get_frame ());
+}
 
-	page->type |= VM_FRAME;
+/* PAGE를 pinned인 FRAME에 올리고 mmu 설정, 끝나면 frame은 unpin */
+static bool
+vm_claim_with_frame (struct page *page, struct frame *frame) {
+	/* Set links, new frame is never shared */
+	frame_rmap_add(frame, page);
+	page->type &= ~VM_CPWRITE;
 	int is_writable = page->type & VM_WRITABLE;
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
 	ASSERT(page->va);
-	if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, is_writable))
-		return false;
-	return swap_in (page, frame->kva);
+	bool succ = pml4_set_page(thread_current()->pml4, page->va, frame->kva, is_writable)
+				&& swap_in (page, frame->kva);
+	if (succ)
+		file_backed_cache_text(page);
+	vm_frame_unpin(frame);
+	return succ;
 }
 
-/* Copy supplemental page table from src to dst */
+/* Copy supplemental page table from src to dst
+ * 영역은 바로 복사하고, page는 frame이나 swap slot이 있어 영역에서 다시 만들 수 없는 것만 복사
+ * frame은 읽기 전용으로 공유, 쓰는 쪽이 vm_handle_wp에서 복사
+ * dst(child)의 pml4는 비워두고 page를 처음 접근할 때 vm_map_frame에서 채움
+ * src의 thread(parent)는 복사가 끝날 때까지만 fork에서 대기, 올라온 page 수만큼 걸림 */
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst,
 		struct supplemental_page_table *src) {
+	struct list_elem *e;
+	for (e = list_begin(&src->vmas); e != list_end(&src->vmas); e = list_next(e)) {
+		struct vma *vma = (struct vma *) malloc(sizeof(struct vma));
+		if (vma == NULL)
+			return false;
+		memcpy(vma, list_entry(e, struct vma, elem), sizeof(struct vma));
+		if (vma->type & VM_MMAP)
+			inode_reopen(vma->inode);
+		list_init(&vma->pages);
+
+		// huge pages are not shared, child reads the file written back here
+		struct vma *src_vma = list_entry(e, struct vma, elem);
+		for (struct list_elem *p = list_begin(&src_vma->pages); p != list_end(&src_vma->pages);
+				p = list_next(p)) {
+			struct page *page = list_entry(p, struct page, vma_elem);
+			if (page->type & VM_HUGE)
+				file_backed_writeback(page);
+		}
+		list_push_back(&dst->vmas, &vma->elem);
+	}
 	return hash_apply(&src->pages, hash_copy_action);
 }
 
 /*
  * 1. uninit인 경우 2. frame에 존재하는 경우, 3.disk or SWAP에 존재하는경우
- * 각 page의 lazy_load_data 복사, frame은 vm_handle_wp에서 복사 되도록 설정 
+ * 각 page의 lazy_load_data 복사, frame은 reverse map에 추가해서 vm_handle_wp에서 복사,
+ * child의 pml4에는 넣지 않고 vm_map_frame에서 mapping, swap slot은 참조 수를 늘려서 공유
  */
 bool hash_copy_action(struct hash_elem *e, void *aux UNUSED)
 {	
 	struct lazy_load_data *cp_aux;
 	struct thread *cur = thread_current();
 	struct page *src_page = hash_entry(e, struct page, hash_elem);
+	if (src_page->type & VM_HUGE)		// child maps the file by small pages
+		return true;
+	// not loaded or dropped file page, child makes it again from its vma
+	if (src_page->vma && (src_page->operations->type == VM_UNINIT
+			|| VM_TYPE(src_page->type) == VM_FILE))
+		return true;
 	struct page *dst_page = (struct page *) malloc(sizeof(struct page));
-	
+	if (dst_page == NULL)
+		return false;
+
+	// keep src frame from being evicted while it is shared
+	struct frame *src_frame = vm_pin_frame(src_page);
+	bool succ = false;
+	if (src_frame && src_page->operations->type == VM_ANON)		// slot copy is not shared
+		anon_drop_swap_cache(src_page);
+
 	// cp and init page
 	memcpy(dst_page, src_page, sizeof(struct page));
-	circular_list_init(&dst_page->cp_elem);
+	dst_page->frame = NULL;
 	dst_page->pml4 = cur->pml4;
+	dst_page->type &= ~VM_ZERO;		// not mapped in child, maps zero on fault
 
 	enum vm_type ty = VM_TYPE(src_page->type);
 	enum vm_type uninit_type = src_page->operations->type;
@@ -326,7 +1191,7 @@ bool hash_copy_action(struct hash_elem *e, void *aux UNUSED)
 	if (uninit_type == VM_UNINIT) {
 		// aux copy for lazy load
 		if (!(cp_aux = (struct lazy_load_data *)malloc(sizeof(struct lazy_load_data))))
-			return false;
+			goto done;
 
 		memcpy(cp_aux, src_page->uninit.aux, sizeof(struct lazy_load_data));
 		dst_page->uninit.aux = cp_aux;
@@ -335,7 +1200,7 @@ bool hash_copy_action(struct hash_elem *e, void *aux UNUSED)
 	} else if (ty & VM_FILE) {
 		// aux copy for lazy load
 		if (!(cp_aux = (struct lazy_load_data *)malloc(sizeof(struct lazy_load_data))))
-			return false;
+			goto done;
 
 		memcpy(cp_aux, src_page->file.data, sizeof(struct lazy_load_data));
 		dst_page->file.data = cp_aux;	
@@ -348,27 +1213,32 @@ bool hash_copy_action(struct hash_elem *e, void *aux UNUSED)
 		// for cpwrite, make page unwritable
 		if (src_page->type & VM_WRITABLE)
 			ASSERT(pml4_set_page(src_page->pml4, src_page->va, src_page->frame->kva, 0));			
-		if (!pml4_set_page(cur->pml4, dst_page->va, dst_page->frame->kva, 0))
-			return false;
 			
 		enum vm_type ty = VM_CPWRITE;
 		if (pml4_is_dirty(src_page->pml4, src_page->va))
 			ty |= VM_DIRTY;
 		dst_page->type |= ty;
 		src_page->type |= ty;
+		frame_rmap_add(src_frame, dst_page);
+		goto end;
 
 	case VM_ANON:		// swap	
-	case VM_FILE:		// disk
-		// make circular linked list to find child process
-		list_insert(&src_page->cp_elem, &dst_page->cp_elem);
+		anon_share_swap_slot(dst_page);
 		goto end;
+	case VM_FILE:		// disk
 		goto end;
 
 	default:
 		PANIC("wrong access");
 	}
 end:
-	return spt_insert_page(&cur->spt, dst_page);
+	succ = spt_insert_page(&cur->spt, dst_page);
+	if (succ && (dst_page->vma = src_page->vma ? vma_find(&cur->spt, dst_page->va) : NULL))
+		list_push_back(&dst_page->vma->pages, &dst_page->vma_elem);
+done:
+	if (src_frame)
+		vm_frame_unpin(src_frame);
+	return succ;
 }
 
 /* Free the resource hold by the supplemental page table */
@@ -377,6 +1247,8 @@ supplemental_page_table_kill (struct supplemental_page_table *spt) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
 	hash_destroy(&spt->pages, hash_free_page);
+	while (!list_empty(&spt->vmas))
+		vma_free(list_entry(list_pop_front(&spt->vmas), struct vma, elem));
 }	
 
 /* spt destory할때 사용하는 함수, exec할 땐 mmap page는 안지우고 살려둠 */
@@ -393,57 +1265,57 @@ void hash_free_page(struct hash_elem *e, void *aux)
 }
 
 /* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
+ * DO NOT MODIFY THIS FUNCTION.
+ * destroy가 끝날 때까지 frame을 pin해서 kswapd나 다른 process가 evict하지 못하도록 함 */
 void
 vm_dealloc_page (struct page *page) {
-	if (!is_alone(&page->cp_elem))
-		list_remove(&page->cp_elem);	
+	vm_pin_frame(page);		// ftb_delete_frame unpins or frees it
+	if (page->vma)
+		list_remove(&page->vma_elem);
 	destroy (page);
 	free (page);
 }
 
 /* 
  * anon or file destory할 때, frame 삭제하는 함수, 삭제한 경우만 true return
- * cpwrite에 의해 frame을 중복 참조하지 않는 경우 경우만 삭제
+ * frame은 vm_dealloc_page에서 pin한 상태, reverse map의 마지막 참조인 경우만 삭제하고
+ * 아니면 unpin해서 남은 page들이 계속 사용
  */
 bool ftb_delete_frame(struct page *delete_page){
-	struct hash_elem *e;
-	if (delete_page->frame){
-		delete_page->type &= ~VM_FRAME;
-		if (is_alone(&delete_page->cp_elem)) {	// pml4 destroy in pml4 destroy
-			if (!(e = hash_delete(&ftb, &delete_page->frame->hash_elem)))
-				return false; 
-
-			free(delete_page->frame);
-			delete_page->frame = NULL;		// dangler pointer	
-			return true;
-		} else {
-			delete_page->frame = NULL;		// dangler pointer	
-			pml4_clear_page(delete_page->pml4, delete_page->va); 	// for keeping pml4 page destory safely
-		}
+	struct frame *frame = delete_page->frame;
+	if (!frame)
+		return false;
+	ASSERT(frame->pinned);
+	if (delete_page->type & VM_HUGE) {		// not in ftb, only this page maps it
+		frame_rmap_remove(frame, delete_page);
+		pml4_clear_page(delete_page->pml4, delete_page->va);
+		palloc_free_multiple(frame->kva, HPG_PAGES);
+		free(frame);
+		return true;
 	}
+	if (file_backed_release_frame(frame, delete_page) == 0) {
+		lock_acquire(&ftb.frame_lock);
+		ftb_remove(frame);
+		lock_release(&ftb.frame_lock);
+		// unmap before freeing, munmap and madvise drop pages of a live process
+		pml4_clear_page(delete_page->pml4, delete_page->va);
+		palloc_free_page(frame->kva);
+		free(frame);
+		return true;
+	}
+	pml4_clear_page(delete_page->pml4, delete_page->va); 	// for keeping pml4 page destory safely
+	vm_frame_unpin(frame);
 	return false;
 }
 
-/* frame을 공유하는 page들이 swap out될 때 사용, kva를 user의 pml4에서 제거 */
+/* frame을 공유하는 page들이 swap out될 때 사용, reverse map과 user의 pml4에서 제거 */
 void disable_redundant_frame(struct page *page) {
 	ASSERT(page->frame);
 
-	page->frame = NULL;				// dangler pointer	
-	page->type &= ~VM_FRAME;
+	frame_rmap_remove(page->frame, page);
 	pml4_clear_page(page->pml4, page->va); 	
 }
 
-/* frame을 공유하는 page들이 swap in될 때 사용, kva를 user의 pml4에 추가 */
-void enable_redundant_frame(struct page *page, struct frame *n_frame){
-	ASSERT(!page->frame);
-	ASSERT(page->type & VM_CPWRITE);
-
-	page->type |= VM_FRAME;
-	page->frame = n_frame;
-	pml4_set_page(page->pml4, n_frame->page->va, n_frame->kva, 0); 
-}	
-
 /* spt hashing 하는 함수 */
 unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED) {
 	const struct page *p = hash_entry(p_, struct page, hash_elem);
@@ -458,33 +1330,3 @@ bool page_less(const struct hash_elem *a_,
 
 	return a->va < b->va;
 }
-
-/* ftb hashing 하는 함수 */
-unsigned frame_hash(const struct hash_elem *p_, void *aux UNUSED) {
-	const struct frame *p = hash_entry(p_, struct frame, hash_elem);
-	return hash_bytes(&p->kva, sizeof p->kva);
-}
-
-/* Returns true if page a precedes page b. */
-bool frame_less(const struct hash_elem *a_,
-           const struct hash_elem *b_, void *aux UNUSED) {
-	const struct frame *a = hash_entry(a_, struct frame, hash_elem);
-	const struct frame *b = hash_entry(b_, struct frame, hash_elem);
-	return a->kva < b->kva;
-}
-
-/* no msync, no need(yet not impl)*/
-static struct frame *find_shared_frame(struct page *page)
-{
-	if (page->type & VM_WRITABLE)
-		return NULL; 
-
-	struct lazy_load_data *data = page->uninit.aux;
-	struct frame *find_frame;
-
-	if (!pml4_set_page(thread_current()->pml4, page->va, find_frame->kva, 0))
-		return NULL;
-	page->type |= VM_CPWRITE;
-	page->uninit.init = NULL;		// not lazy load
-	return find_frame;
-}
\ No newline at end of file